@@ -20,6 +20,7 @@
 #include "util.hpp"
 #include "orderentry.grpc.pb.h"
 #include "marketdatatypes.hpp"
+#include "marketdatarecord.hpp"
 #include "clientfeedhandler.hpp"
 #include "clientorderbook.hpp"
 #include "centerformatting.hpp"
@@ -49,11 +50,14 @@ private:
     void interpretResponseType(OEResponse& oe_response);
     void subscribeToDataPlatform(const char* hostname, const char* port);
     void readMarketData();
+    void processDatagram(std::size_t received);
     void processMarketData();
     void processAddOrderData();
     void processModifyOrderData();
+    void processReplaceOrderData();
     void processCancelOrderData();
     void processFillOrderData();
+    void processInstrumentData();
     bool userEnteredCommand(const std::string& command);
     void processNotificationData();
     bool constructNewOrderRequest(OERequest& request, const std::string& input);
@@ -64,6 +68,7 @@ private:
     bool getUserInput(OERequest& request);
     template<typename OrderType>
     bool setSide(OrderType& ordertype, char side);
+    bool setInstrument(Common* common, const std::string& ticker) const;
     void promptUserID();
     void interpretAck(const NewOrderAck& new_ack);
     void interpretAck(const ModOrderAck& mod_ack);
@@ -75,6 +80,7 @@ private:
     std::string commonStr(int64_t timestamp, const Common& common);
     std::string commonStr(const Common& common);
     std::string timestampStr(int64_t timestamp) const;
+    std::string tickerStr(uint32_t instrument_id) const;
     uint64_t getUserID() const {return userID_;}
     void printInfoBox(bool clear_prev = true);
     void reprintInterface();
@@ -107,7 +113,8 @@ private:
         "-ticker ", "-orderid "
     };
     uint64_t userID_ = 0;
-    char buffer_[64] = {0};
+    char buffer_[util::md_max_datagram_len_] = {0};
+    alignas(8) char record_[64] = {0}; // record being processed
     uint8_t data_length_ = 0;
     uint8_t packet_type_ = 0;
     uint8_t prev_height_ = 0;
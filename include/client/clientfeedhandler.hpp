@@ -9,16 +9,26 @@
 
 namespace client {
 using Ticker = uint64_t;
+using InstrumentID = uint32_t;
 using BookIndex = uint16_t;
+constexpr InstrumentID NO_INSTRUMENT = -1;
 using OrderID = uint64_t;
 using Order = AddOrderData;
+// Market data only carries instrument ids, the 'S' definitions map them back to
+// symbols and are replayed by the data platform whenever we subscribe.
 class ClientFeedHandler {
 public:
+    void defineInstrument(InstrumentData* instrument) {
+        if (symbols_.size() <= instrument->instrument_id)
+            symbols_.resize(instrument->instrument_id + 1, 0);
+        symbols_[instrument->instrument_id] = instrument->symbol;
+        instruments_[instrument->symbol] = instrument->instrument_id;
+    }
     void addOrder(AddOrderData* new_order) {
-        auto itr = tickers_.find(new_order->ticker);
-        if (itr == tickers_.end()) {
-            orderbooks_.emplace_back(ClientOrderBook(new_order->ticker));
-            itr = tickers_.emplace(new_order->ticker, orderbooks_.size() - 1).first;
+        auto itr = books_.find(new_order->instrument_id);
+        if (itr == books_.end()) {
+            orderbooks_.emplace_back(ClientOrderBook(symbol(new_order->instrument_id)));
+            itr = books_.emplace(new_order->instrument_id, orderbooks_.size() - 1).first;
         }
         uint16_t book_id = itr->second;
         new_order->book_index = book_id;
@@ -59,6 +69,16 @@ public:
         }
         itr->second.quantity = modify_order->quantity;
     }
+    void replaceOrder(ReplaceOrderData* replace_order) {
+        auto itr = orders_.find(replace_order->order_id);
+        if (itr == orders_.end())
+            return;
+        auto& book = orderbooks_[itr->second.book_index];
+        book.removeFromBook(itr->second.is_buy_side, itr->second.quantity, itr->second.price);
+        book.addToBook(itr->second.is_buy_side, replace_order->quantity, replace_order->price);
+        itr->second.price = replace_order->price;
+        itr->second.quantity = replace_order->quantity;
+    }
     void fillOrder(FillOrderData* fill) {
         auto itr = orders_.find(fill->order_id);
         if (itr == orders_.end())
@@ -80,8 +100,8 @@ public:
         return &itr->second;
     }
     ClientOrderBook* subscribe(Ticker ticker) {
-        auto itr = tickers_.find(ticker);
-        if (itr == tickers_.end()) {
+        auto itr = books_.find(instrumentID(ticker));
+        if (itr == books_.end()) {
             return nullptr;
         }
         return &orderbooks_[itr->second];
@@ -90,11 +110,21 @@ public:
         auto itr = orders_.find(order_id);
         if (itr == orders_.end())
             return 0;
-        return itr->second.ticker;
+        return symbol(itr->second.instrument_id);
+    }
+    InstrumentID instrumentID(Ticker ticker) const {
+        auto itr = instruments_.find(ticker);
+        return itr == instruments_.end() ? NO_INSTRUMENT : itr->second;
+    }
+    // 0 until the instrument's definition arrives
+    Ticker symbol(InstrumentID instrument_id) const {
+        return instrument_id < symbols_.size() ? symbols_[instrument_id] : 0;
     }
 private:
     std::vector<ClientOrderBook> orderbooks_;
-    std::unordered_map<Ticker, BookIndex> tickers_;
+    std::unordered_map<InstrumentID, BookIndex> books_;
+    std::unordered_map<Ticker, InstrumentID> instruments_;
+    std::vector<Ticker> symbols_;
     std::unordered_map<OrderID, Order> orders_;
 };
 }
@@ -9,8 +9,8 @@ namespace client {
 struct AddOrderData {
     int64_t timestamp;
     uint64_t order_id;
-    uint64_t ticker;
     uint64_t price;
+    uint32_t instrument_id;
     int32_t quantity;
     uint8_t is_buy_side; // purposefully misaligned
     uint16_t book_index; // padding helps us worry less about cast
@@ -22,6 +22,13 @@ struct ModOrderData {
     int32_t quantity;
 };
 
+struct ReplaceOrderData {
+    int64_t timestamp;
+    uint64_t order_id;
+    uint64_t price;
+    int32_t quantity;
+};
+
 struct CancelOrderData {
     int64_t timestamp;
     uint64_t order_id;
@@ -30,11 +37,16 @@ struct CancelOrderData {
 struct FillOrderData {
     int64_t timestamp;
     uint64_t order_id;
-    uint64_t ticker;
     uint64_t fill_id;
+    uint32_t instrument_id;
     int32_t quantity;
 };
 
+struct InstrumentData {
+    uint64_t symbol;
+    uint32_t instrument_id;
+};
+
 struct NotificationData {
     int64_t timestamp;
     uint8_t flag;
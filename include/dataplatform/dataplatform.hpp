@@ -6,52 +6,64 @@
 #include <grpc/grpc.h>
 #include <grpcpp/grpcpp.h>
 #include <thread>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
 
 #include "orderentry.grpc.pb.h"
+#include "marketdatarecord.hpp"
+#include "shmring.hpp"
 
 namespace dataplatform {
-using MDResponse = orderentry::MarketDataResponse;
+using MDBatch = orderentry::MarketDataBatch;
 using MDRequest = orderentry::InitiateMarketDataStreamRequest;
-using type = orderentry::MarketDataResponse::OrderEntryTypeCase;
 using udp = boost::asio::ip::udp;
-constexpr uint8_t add_data_len_ = 37;
-constexpr uint8_t mod_data_len_ = 20;
-constexpr uint8_t cancel_data_len_ = 16;
-constexpr uint8_t fill_data_len_ = 46;
-constexpr uint8_t notification_len_ = 1;
+using Clock = std::chrono::steady_clock;
+// Records are packed into datagrams that go out once full. On the grpc stream every
+// batch ends with a flush, as the batch is everything the server had; on the shared
+// memory bus a datagram is flushed once its first record has waited flush_interval.
 class DataPlatform : public std::enable_shared_from_this<DataPlatform> {
 public:
-    DataPlatform(std::shared_ptr<grpc::Channel> channel);
+    static constexpr std::chrono::microseconds DEFAULT_FLUSH_INTERVAL{50};
+    DataPlatform(std::shared_ptr<grpc::Channel> channel,
+        std::chrono::microseconds flush_interval = DEFAULT_FLUSH_INTERVAL);
     void initiateMarketDataStream();
+    // same host as the server: busy polls its shared memory bus until the server stops
+    void initiateSharedMemoryStream(const std::string& name);
 private:
     void acceptSubscriber();
-    void serialiseMarketData();
-    template<typename Data>
-    void serialiseBytes(char*& ptr, Data timestamp);     
-    void serialiseAddOrder();
-    void serialiseModOrder();
-    void serialiseCancel();
-    void serialiseNotification();
-    void serialiseFill();
+    struct Datagram {
+        std::array<char, util::md_max_datagram_len_> bytes;
+        std::size_t len = util::md_datagram_header_len_;
+        uint16_t count = 0;
+    };
+    void forwardRecord(const char* record, std::size_t len);
+    void flushDatagram();
+    void addSubscriber(const udp::endpoint& subscriber);
     grpc::ClientContext context_;
-    MDResponse market_data_;
+    MDBatch market_data_batch_;
+    std::array<char, util::ShmRing::RECORD_SIZE> bus_record_;
     grpc::Status status_;
     std::unique_ptr<orderentry::MarketDataService::Stub> stub_;
     boost::asio::io_context io_context;
     udp::socket socket_;
     udp::endpoint temp_remote_endpoint_;
-    std::array<char, 255> temp_buffer_;
     std::array<char, 1> conn_buffer_;
+    // reading thread only
+    Datagram datagram_;
+    Clock::time_point first_pending_;
+    uint64_t next_sequence_ = 1;
+    std::chrono::microseconds flush_interval_;
+    char session_[util::md_session_len_];
+    // subscribers join on the io thread while the reading thread sends
+    std::mutex subscribers_mutex_;
     std::set<udp::endpoint> subscribers_;
+    // every 'S' record so far, new subscribers get these before any orders
+    std::vector<std::string> instruments_;
 };
-template<typename Data>
-void DataPlatform::serialiseBytes(char*& ptr, Data data) {            
-    std::memcpy(ptr, &data, sizeof(data));
-    ptr += sizeof(data);
-
-}
 }
 
 #endif
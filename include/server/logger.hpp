@@ -86,6 +86,8 @@ public:
         const bool is_power_of_two = size && !(size & (size - 1));
         assert(is_power_of_two);
         if (!buffer_) throw std::bad_alloc();
+        for (std::size_t i = 0; i < size; ++i) // malloc leaves the flags uninitialised
+            new (&buffer_[i].is_constructed) std::atomic<bool>(false);
     }
     ~Queue() {
         while (front()) pop();
@@ -7,12 +7,14 @@
 
 #include "order.hpp"
 #include "limit.hpp"
+#include "limitbook.hpp"
 #include "level.hpp"
+#include "priceladder.hpp"
 #include "matchresult.hpp"
 #include "util.hpp"
 
 using order_id = uint64_t;
-using limitbook = std::unordered_map<order_id, server::tradeorder::Limit>;
+using limitbook = server::tradeorder::LimitBook;
 
 namespace server {
 namespace matching {
@@ -20,89 +22,98 @@ using Order = ::tradeorder::Order;
 using price = uint64_t;
 using Level = server::tradeorder::Level;
 using Limit = server::tradeorder::Limit;
-using askbook = std::map<price, Level>;
-using bidbook = std::map<price, Level, std::greater<price>>;
+using LimitInfo = server::tradeorder::LimitInfo;
+using limit_index = server::tradeorder::limit_index;
+using askbook = server::tradeorder::PriceLadder<std::less<price>>;
+using bidbook = server::tradeorder::PriceLadder<std::greater<price>>;
 
 class FIFOMatcher {
 public:
     template<typename Book>
     static MatchResult FIFOMatch(Order& order_to_match, Book& book, limitbook& limitbook) {
-        auto book_itr = book.begin();
-        Level& book_lvl = book_itr->second;
-        Limit* book_order = book_lvl.head;
-        uint64_t order_price = order_to_match.getPrice();
         MatchResult match_result;
-        while (book_itr != book.end()) {
-            if (noMatchingLevel(book, order_price, book_itr->first)) {
-                return match_result;
+        FIFOMatch(order_to_match, book, limitbook, match_result);
+        return match_result;
+    }
+    // fills are handed to sink as they happen, sink is a MatchResult or FillStream
+    template<typename Book, typename FillSink>
+    static void FIFOMatch(Order& order_to_match, Book& book, limitbook& limitbook, FillSink& match_result) {
+        uint64_t order_price = order_to_match.getPrice();
+        Level* book_lvl = book.best();
+        while (book_lvl != nullptr) {
+            if (noMatchingLevel(book, order_price, book_lvl->price)) {
+                return;
             }
-            book_order = book_lvl.head;
-            if (orderFullyMatchedInLevel(book_order, order_to_match, match_result, book_lvl, limitbook, book, book_itr)) {
-                return match_result;
+            bool fully_matched = orderFullyMatchedInLevel(order_to_match, match_result, *book_lvl, limitbook);
+            if (book_lvl->getLevelOrderCount() == 0) {
+                book.erase(*book_lvl);
             }
-            if (book_lvl.getLevelOrderCount() == 0) {
-                book.erase(book_itr++);
+            if (fully_matched) {
+                return;
             }
-            else ++book_itr;
-            book_lvl = book_itr->second;
+            book_lvl = book.best();
         }
-        return match_result;
     }
 private:
-    template<typename Book, typename BookItr>
-    static bool orderFullyMatchedInLevel(Limit*& book_order, Order& order_to_match, MatchResult& match_result, 
-    Level& book_lvl, limitbook& limitbook, Book& book, BookItr& book_itr) {
-        while (ordersInLevel(book_order)) {
-            uint32_t fill_qty = std::min(book_order->order.getCurrQty(), order_to_match.getCurrQty());
+    template<typename FillSink>
+    static bool orderFullyMatchedInLevel(Order& order_to_match, FillSink& match_result, 
+    Level& book_lvl, limitbook& limitbook) {
+        while (ordersInLevel(book_lvl.head)) {
+            Limit& book_order = limitbook[book_lvl.head];
+            uint32_t fill_qty = std::min(book_order.quantity, order_to_match.getCurrQty());
             order_to_match.decreaseQty(fill_qty);
-            book_order->order.decreaseQty(fill_qty);
-            addFills(match_result, order_to_match, book_order, fill_qty);
+            book_order.quantity -= fill_qty;
+            book_lvl.total_quantity -= fill_qty;
+            addFills(match_result, order_to_match, book_order, limitbook.info(book_lvl.head), fill_qty);
             if (orderIsFullyMatched(order_to_match)) { // order_to_match is fully matched
-                if (book_order->order.getCurrQty() == 0) {
-                    removeOrderFromBook(book_order, book_lvl, limitbook);
-                }
-                if (book_lvl.getLevelOrderCount() == 0) {
-                    book.erase(book_itr++);
+                if (book_order.quantity == 0) {
+                    removeOrderFromBook(book_lvl, limitbook);
                 }
                 match_result.setOrderFilled();
                 return true;
             }
-            removeOrderFromBook(book_order, book_lvl, limitbook);
+            removeOrderFromBook(book_lvl, limitbook);
         }
         return false;
     }
-    static void removeOrderFromBook(Limit*& book_lim, Level& book_lvl, limitbook& limitbook) {
-        Limit* next_limit = book_lim->next_limit;
-        if (next_limit != nullptr) {
-            next_limit->prev_limit = nullptr;
+    static void removeOrderFromBook(Level& book_lvl, limitbook& limitbook) {
+        const limit_index book_lim_idx = book_lvl.head;
+        const Limit& book_lim = limitbook[book_lim_idx];
+        limit_index next_limit = book_lim.next_limit;
+        if (next_limit != server::tradeorder::NO_LIMIT) {
+            limitbook[next_limit].prev_limit = server::tradeorder::NO_LIMIT;
+        }
+        else {
+            book_lvl.tail = server::tradeorder::NO_LIMIT;
         }
         book_lvl.head = next_limit;
-        uint64_t book_lim_id = book_lim->order.getOrderID();
-        book_lim = next_limit;
-        limitbook.erase(book_lim_id);
+        book_lvl.removeFromLevel(book_lim.quantity);
+        limitbook.erase(book_lim_idx);
     }
-    static void addFills(MatchResult& match_result, Order& order, Limit* book_lim, uint32_t fill_qty) {
+    template<typename FillSink>
+    static void addFills(FillSink& match_result, Order& order, const Limit& book_lim, 
+    const LimitInfo& book_lim_info, uint32_t fill_qty) {
         int64_t filltime = util::getUnixTimestamp();
         bool order_filled = order.getCurrQty() == 0;
-        bool book_lim_filled = book_lim->order.getCurrQty() == 0;
+        bool book_lim_filled = book_lim.quantity == 0;
         match_result.addFill(
             filltime,
             order.getTicker(),
-            book_lim->order.getOrderID(), 
-            book_lim->order.getPrice(),
+            book_lim.order_id, 
+            book_lim.price,
             fill_qty,
             book_lim_filled,
-            book_lim->order.getUserID(),
-            order.connection_
+            book_lim_info.user_id,
+            book_lim_info.connection
         );
         match_result.addFill(
             filltime,
             order.getTicker(),
             order.getOrderID(),
-            book_lim->order.getPrice(),
+            book_lim.price,
             fill_qty,
             order_filled,
-            book_lim->order.getUserID(),
+            order.getUserID(),
             order.connection_
         );
     }
@@ -112,7 +123,7 @@ private:
     static bool noMatchingLevel(askbook&, uint64_t order_price, uint64_t ask_price) {
         return order_price < ask_price;
     }
-    static bool ordersInLevel(const Limit* order) {return order != nullptr;}
+    static bool ordersInLevel(limit_index order) {return order != server::tradeorder::NO_LIMIT;}
     static bool orderIsFullyMatched(const Order& order_to_match) {return order_to_match.getCurrQty() == 0;}
 };
 
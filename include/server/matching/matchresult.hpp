@@ -1,13 +1,20 @@
 #ifndef MATCH_RESULT_HPP
 #define MATCH_RESULT_HPP
 
+#include <utility>
+
 #include "fill.hpp"
+#include "smallvector.hpp"
 
 namespace server {
 namespace matching {
 using Fill = ::info::Fill;
+// Fills buffered inline: every match adds two, so an order crossing up to
+// INLINE_FILLS / 2 resting orders never allocates.
 class MatchResult {
 public:
+    static constexpr std::size_t INLINE_FILLS = 16;
+    using FillBuffer = util::SmallVector<Fill, INLINE_FILLS>;
     void addFill(int64_t timestamp, uint64_t ticker, uint64_t order_id, 
     uint64_t price, uint16_t fill_qty, uint8_t full_fill, uint64_t user_id,
     OrderEntryStreamConnection* connection) {
@@ -24,11 +31,38 @@ public:
     uint numFills() {
         return fills_.size();
     }
-    std::vector<Fill>& getFills() {
+    FillBuffer& getFills() {
         return fills_;
     }
 private:
-    std::vector<Fill> fills_;
+    FillBuffer fills_;
+    bool order_filled_ = false;
+};
+
+// Same interface as MatchResult, but each fill goes straight to the callback
+// instead of being buffered.
+template<typename Callback>
+class FillStream {
+public:
+    explicit FillStream(Callback callback): callback_(std::move(callback)) {}
+    void addFill(int64_t timestamp, uint64_t ticker, uint64_t order_id, 
+    uint64_t price, uint16_t fill_qty, uint8_t full_fill, uint64_t user_id,
+    OrderEntryStreamConnection* connection) {
+        callback_(Fill(timestamp, ticker, order_id, price, fill_qty, full_fill, user_id, connection));
+        ++num_fills_;
+    }
+    bool orderCompletelyFilled() const {
+        return order_filled_;
+    }
+    void setOrderFilled() {
+        order_filled_ = true;
+    }
+    uint numFills() {
+        return num_fills_;
+    }
+private:
+    Callback callback_;
+    uint num_fills_ = 0;
     bool order_filled_ = false;
 };
 }
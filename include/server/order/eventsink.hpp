@@ -0,0 +1,158 @@
+#ifndef EVENT_SINK_HPP
+#define EVENT_SINK_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "order.hpp"
+#include "ordertypes.hpp"
+#include "fill.hpp"
+#include "util.hpp"
+
+// Everything an orderbook reports leaves through its EventSink, a policy class taken
+// as a template parameter so the calls are resolved and inlined at compile time.
+// A sink provides:
+//     void onAdd(const Order& order);                    order rests in the book
+//     void onFill(const Fill& fill, const Order& order); fill while matching order
+//     void onModify(const info::ModifyOrder& modify);    quantity amended in place
+//     void onReplace(const info::ModifyOrder& modify);   moved to a new price
+//     void onCancel(const info::CancelOrder& cancel);
+//     void onReject(RejectReason reason, OrderEntryStreamConnection* connection,
+//         uint64_t user_id, uint64_t order_id, uint64_t ticker);
+//     void onBatchBegin();                               batched callers bracket a burst
+//     void onBatchEnd();                                 of commands, output may be held
+//                                                        back until the end
+//     void onHandOff();                                  a book is moving to another
+//                                                        thread, output so far must stay
+//                                                        ahead of the new thread's
+// Sinks are copied into each book, so any shared output is held by pointer.
+// A batch is bracketed on one copy but events arrive on the books' copies, all on
+// the calling thread, so deferred output is kept per thread.
+
+namespace server {
+namespace tradeorder {
+// mirrors orderentry::OrderEntryRejection::RejectionReason
+enum class RejectReason : uint8_t {
+    unknown = 0,
+    order_not_found = 1,
+    order_id_already_present = 2,
+    orderbook_not_found = 3,
+    ticker_not_found = 4,
+    modify_wrong_side = 5,
+    modification_trivial = 6,
+    wrong_user_id = 7,
+};
+
+struct NullEventSink {
+    void onAdd(const ::tradeorder::Order&) {}
+    void onFill(const info::Fill&, const ::tradeorder::Order&) {}
+    void onModify(const info::ModifyOrder&) {}
+    void onReplace(const info::ModifyOrder&) {}
+    void onCancel(const info::CancelOrder&) {}
+    void onReject(RejectReason, OrderEntryStreamConnection*, uint64_t, uint64_t, uint64_t) {}
+    void onBatchBegin() {}
+    void onBatchEnd() {}
+    void onHandOff() {}
+};
+
+// keeps every event, for tests
+class RecordingEventSink {
+public:
+    enum class EventType : uint8_t {add, fill, modify, replace, cancel, reject};
+    struct Event {
+        EventType type;
+        uint64_t order_id;
+        uint64_t price;
+        uint32_t quantity;
+        RejectReason reason;
+        uint64_t user_id = 0; // fills only, with the connection
+        const OrderEntryStreamConnection* connection = nullptr;
+    };
+    void onAdd(const ::tradeorder::Order& order) {
+        record(EventType::add, order.getOrderID(), order.getPrice(), order.getCurrQty());
+    }
+    void onFill(const info::Fill& fill, const ::tradeorder::Order&) {
+        record(EventType::fill, fill.order_id, fill.price, fill.fill_qty);
+        events_.back().user_id = fill.user_id;
+        events_.back().connection = fill.connection;
+    }
+    void onModify(const info::ModifyOrder& modify) {
+        record(EventType::modify, modify.order_id, modify.price, modify.quantity);
+    }
+    void onReplace(const info::ModifyOrder& modify) {
+        record(EventType::replace, modify.order_id, modify.price, modify.quantity);
+    }
+    void onCancel(const info::CancelOrder& cancel) {
+        record(EventType::cancel, cancel.order_id, 0, 0);
+    }
+    void onReject(RejectReason reason, OrderEntryStreamConnection*, uint64_t, uint64_t order_id, uint64_t) {
+        record(EventType::reject, order_id, 0, 0, reason);
+    }
+    void onBatchBegin() {}
+    void onBatchEnd() {}
+    void onHandOff() {}
+    const std::vector<Event>& events() const {return events_;}
+    void clear() {events_.clear();}
+private:
+    void record(EventType type, uint64_t order_id, uint64_t price, uint32_t quantity,
+    RejectReason reason = RejectReason::unknown) {
+        events_.push_back({type, order_id, price, quantity, reason});
+    }
+
+    std::vector<Event> events_;
+};
+
+// Appends fixed size binary records to a stream, one per event:
+// type char, timestamp, order id, price, quantity. Prices are zero where the
+// event has none, rejections carry the reason in place of a quantity.
+class JournalEventSink {
+public:
+    explicit JournalEventSink(std::ostream* journal = nullptr): journal_(journal) {}
+    void onAdd(const ::tradeorder::Order& order) {
+        write('A', order.getOrderID(), order.getPrice(), order.getCurrQty());
+    }
+    void onFill(const info::Fill& fill, const ::tradeorder::Order&) {
+        write('F', fill.order_id, fill.price, fill.fill_qty);
+    }
+    void onModify(const info::ModifyOrder& modify) {
+        write('M', modify.order_id, modify.price, modify.quantity);
+    }
+    void onReplace(const info::ModifyOrder& modify) {
+        write('R', modify.order_id, modify.price, modify.quantity);
+    }
+    void onCancel(const info::CancelOrder& cancel) {
+        write('C', cancel.order_id, 0, 0);
+    }
+    void onReject(RejectReason reason, OrderEntryStreamConnection*, uint64_t, uint64_t order_id, uint64_t) {
+        write('X', order_id, 0, static_cast<uint32_t>(reason));
+    }
+    void onBatchBegin() {}
+    void onBatchEnd() {
+        if (journal_ != nullptr)
+            journal_->flush();
+    }
+    void onHandOff() {onBatchEnd();}
+#pragma pack(push, 1)
+    struct Record {
+        char type;
+        int64_t timestamp;
+        uint64_t order_id;
+        uint64_t price;
+        uint32_t quantity;
+    };
+#pragma pack(pop)
+private:
+    void write(char type, uint64_t order_id, uint64_t price, uint32_t quantity) {
+        if (journal_ == nullptr)
+            return;
+        Record record{type, util::getUnixTimestamp(), order_id, price, quantity};
+        journal_->write(reinterpret_cast<const char*>(&record), sizeof(record));
+    }
+
+    std::ostream* journal_;
+};
+}
+}
+
+#endif
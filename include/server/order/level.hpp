@@ -5,31 +5,27 @@
 
 namespace server {
 namespace tradeorder {
+// order count and quantity are kept up to date by every add, fill, modify
+// and cancel touching the level, so depth queries never walk the queue
 struct Level {
-    uint16_t getLevelOrderCount() {
-        uint16_t cnt = 0;
-        Limit* headptr = head;
-        while (headptr != nullptr) {
-            if (headptr->order.getCurrQty() != 0)
-                ++cnt;
-            headptr = headptr->next_limit;
-        }
-        return cnt;
+    uint32_t getLevelOrderCount() const {return order_count;}
+    uint64_t getLevelOrderQuantity() const {return total_quantity;}
+    void addToLevel(uint32_t qty) {
+        ++order_count;
+        total_quantity += qty;
     }
-    uint32_t getLevelOrderQuantity() {
-        uint32_t order_qty = 0;
-        Limit* headptr = head;
-        while (headptr != nullptr) {
-            order_qty += headptr->order.getCurrQty();
-            headptr = headptr->next_limit;
-        }
-        return order_qty;
+    void removeFromLevel(uint32_t remaining_qty) {
+        --order_count;
+        total_quantity -= remaining_qty;
     }
     Level(uint64_t price): price(price) {}
-    Limit* head = nullptr;
-    Limit* tail = nullptr;
+    Level() = default;
+    limit_index head = NO_LIMIT;
+    limit_index tail = NO_LIMIT;
     uint8_t is_buy_side = 0;
     uint64_t price = 0;
+    uint32_t order_count = 0;
+    uint64_t total_quantity = 0;
 };
 }
 }
@@ -1,22 +1,47 @@
 #ifndef LIMIT_HPP
 #define LIMIT_HPP
 
+#include <cstdint>
+
 #include "order.hpp"
 
 namespace server {
 namespace tradeorder {
-struct Level;
-struct Limit { 
-    Limit(const ::tradeorder::Order& order):
-        order(order)
+using limit_index = uint32_t;
+static constexpr limit_index NO_LIMIT = static_cast<limit_index>(-1);
+
+// Hot half of a resting order: only what matching and queue maintenance touch,
+// two to a cache line. Queue links are indices into the owning LimitBook's pool.
+struct alignas(32) Limit {
+    Limit(const ::tradeorder::Order& order)
+        : order_id(order.getOrderID())
+        , price(order.getPrice())
+        , quantity(order.getCurrQty())
+        , is_buy_side(order.isBuySide())
     {}
     Limit() = default;
-    ~Limit() {}
-    //uint64_t timestamp;
-    ::tradeorder::Order order;
-    Limit* next_limit = nullptr;
-    Limit* prev_limit = nullptr;
-    Level* current_level = nullptr;
+    uint64_t order_id = 0;
+    uint64_t price = 0;
+    uint32_t quantity = 0;
+    limit_index next_limit = NO_LIMIT;
+    limit_index prev_limit = NO_LIMIT;
+    uint8_t is_buy_side = 0;
+};
+static_assert(sizeof(Limit) == 32, "Limit must stay half a cache line");
+
+// Cold half, held by the LimitBook in a parallel array under the same index.
+struct LimitInfo {
+    LimitInfo(const ::tradeorder::Order& order)
+        : connection(order.connection_)
+        , user_id(order.getUserID())
+        , ticker(order.getTicker())
+        , initial_quantity(order.getInitQty())
+    {}
+    LimitInfo() = default;
+    OrderEntryStreamConnection* connection = nullptr;
+    uint64_t user_id = 0;
+    uint64_t ticker = 0;
+    uint32_t initial_quantity = 0;
 };
 }
 }
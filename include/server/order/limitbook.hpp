@@ -0,0 +1,75 @@
+#ifndef LIMIT_BOOK_HPP
+#define LIMIT_BOOK_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "order.hpp"
+#include "limit.hpp"
+#include "orderindex.hpp"
+#include "slabpool.hpp"
+
+namespace server {
+namespace tradeorder {
+// resting orders of one orderbook: hot Limit nodes come from a per-book slab pool,
+// their cold LimitInfo sits in a parallel array, and both are found by order ID
+// through the direct-mapped index
+class LimitBook {
+public:
+    using order_id = uint64_t;
+    using index = limit_index;
+    static constexpr std::size_t PREALLOCATED_LIMITS = 1024;
+    LimitBook(std::size_t prealloc = PREALLOCATED_LIMITS)
+        : pool_(prealloc)
+        , info_(pool_.capacity())
+    {}
+    // NO_LIMIT if the order is not resting
+    index find(const order_id id) const {return index_.find(id);}
+    void prefetch(const order_id id) const {index_.prefetch(id);}
+    // NO_LIMIT if the order ID is already resting
+    index emplace(const ::tradeorder::Order& order) {
+        if (index_.find(order.getOrderID()) != OrderIndex::NIL)
+            return NO_LIMIT;
+        const index idx = pool_.acquire(order);
+        if (idx >= info_.size())
+            info_.resize(pool_.capacity());
+        info_[idx] = LimitInfo(order);
+        index_.insert(order.getOrderID(), idx);
+        return idx;
+    }
+    void erase(const index idx) {
+        index_.erase(pool_[idx].order_id);
+        pool_.release(idx);
+    }
+    Limit& operator[](const index idx) {return pool_[idx];}
+    const Limit& operator[](const index idx) const {return pool_[idx];}
+    LimitInfo& info(const index idx) {return info_[idx];}
+    const LimitInfo& info(const index idx) const {return info_[idx];}
+    // reassembles the resting order from its hot and cold halves
+    ::tradeorder::Order toOrder(const index idx) const;
+    std::size_t size() const {return index_.size();}
+    std::size_t poolCapacity() const {return pool_.capacity();}
+private:
+    static_assert(util::SlabPool<Limit>::NIL == NO_LIMIT && OrderIndex::NIL == NO_LIMIT,
+        "pool, index and queue links share one null index");
+
+    util::SlabPool<Limit> pool_;
+    std::vector<LimitInfo> info_;
+    OrderIndex index_;
+};
+
+inline ::tradeorder::Order LimitBook::toOrder(const index idx) const {
+    const Limit& limit = pool_[idx];
+    const LimitInfo& limit_info = info_[idx];
+    ::tradeorder::Order order(limit.is_buy_side, limit_info.connection, limit.price,
+        limit_info.initial_quantity, info::OrderCommon(limit.order_id, limit_info.user_id, limit_info.ticker));
+    if (limit.quantity > limit_info.initial_quantity) // modified upwards in place
+        order.increaseQty(limit.quantity - limit_info.initial_quantity);
+    else
+        order.decreaseQty(limit_info.initial_quantity - limit.quantity);
+    return order;
+}
+}
+}
+
+#endif
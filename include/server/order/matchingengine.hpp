@@ -0,0 +1,664 @@
+#ifndef MATCHING_ENGINE_HPP
+#define MATCHING_ENGINE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "orderbook.hpp"
+#include "eventsink.hpp"
+#include "mpscring.hpp"
+#include "histogram.hpp"
+#include "nullmutex.hpp"
+#include "symboldirectory.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace server {
+namespace tradeorder {
+// Fixed size command handed from the rpc threads to a matching thread. It carries no
+// session pointer, the session may be gone by the time the command is applied, so
+// sinks route results by user id.
+struct EngineCommand {
+    enum class Type : uint8_t {add, modify, cancel, create, retire, migrate, adopt};
+    Type type;
+    uint8_t is_buy_side;
+    uint32_t quantity; // ladder ticks for create, destination shard for migrate
+    uint64_t price;
+    uint64_t order_id;
+    uint64_t user_id;
+    instrument_id instrument;
+};
+
+// Each orderbook is owned by exactly one matching thread (a shard). Books start on shard
+// instrument id % number of shards and may be moved later, producers look the owner up
+// in a routing table on every submit.
+// Any thread may submit orders, they are pushed onto the owning shard's inbound ring
+// and applied there in arrival order, so the books themselves take no locks.
+// Rejections raised on a shard go to that shard's own copy of the sink.
+// Books created or retired while running are applied by the owning thread, in order
+// with the orders around them. Books are only read through subscribe() after stop().
+// A shard drains up to MAX_BATCH queued commands at a time, groups them by book and
+// prefetches what each will touch before applying any, sink output is flushed once
+// per batch.
+// Owners count the commands and matching time spent on each book. With rebalancing
+// enabled a background thread periodically moves a book from the busiest shard to the
+// idlest one. A move holds new commands for the book back until the old owner has
+// applied everything already queued for it, then hands the book over on the new
+// owner's ring ahead of them, so a book never sees its commands out of order.
+template<typename EventSink>
+class BasicMatchingEngine {
+public:
+    using OrderBook = BasicOrderBook<EventSink, util::NullMutex>;
+    using SubscribeResult = std::pair<bool, OrderBook&>;
+    static constexpr std::size_t DEFAULT_RING_CAPACITY = 1 << 16;
+    static constexpr std::size_t MAX_BATCH = 64;
+    // ids at or above this are rejected, the routing table is sized up front
+    static constexpr instrument_id MAX_INSTRUMENTS = 4096;
+    // a shard must be busy for this share of the interval before books move off it
+    static constexpr uint64_t MIN_BUSY_PERCENT = 10;
+    // and be this much busier than the idlest shard
+    static constexpr uint64_t MIN_IMBALANCE_PERCENT = 25;
+    using BatchHistogram = util::Log2Histogram<7>; // 1 to 64
+    struct BookLoad {
+        uint64_t messages; // commands applied to the book
+        uint64_t busy_ns;  // time spent applying them
+    };
+    // which book to move and where, book is NO_INSTRUMENT if nothing should move
+    struct Migration {
+        instrument_id book;
+        uint32_t to;
+    };
+    BasicMatchingEngine(uint32_t num_shards, EventSink sink = EventSink(),
+        std::size_t ring_capacity = DEFAULT_RING_CAPACITY, bool pin_threads = false);
+    BasicMatchingEngine(const BasicMatchingEngine&) = delete;
+    BasicMatchingEngine& operator=(const BasicMatchingEngine&) = delete;
+    ~BasicMatchingEngine() {stop();}
+    void start();
+    // drains every ring before joining, submit nothing once stop() is called
+    void stop();
+    void addOrder(const ::tradeorder::Order& order);
+    void modifyOrder(const info::ModifyOrder& modify_order);
+    void cancelOrder(const info::CancelOrder& cancel_order);
+    // while running these are queued to the owning thread, true means queued
+    bool createOrderBook(uint64_t symbol, uint32_t ladder_ticks = 0);
+    bool retireOrderBook(uint64_t symbol);
+    // one move at a time, false if the symbol is unknown, already on that shard or
+    // another move is still in flight. While running true means queued.
+    bool migrateOrderBook(uint64_t symbol, uint32_t shard);
+    // moves one book off the busiest shard if the load since the last call is skewed
+    // enough, true if a move was queued
+    bool rebalance();
+    // call before start(), runs rebalance() every interval while running
+    void enableRebalancing(std::chrono::milliseconds interval) {rebalance_interval_ = interval;}
+    bool migrating() const {return migrating_.load();}
+    // zeros for unknown symbols
+    BookLoad bookLoad(uint64_t symbol) const;
+    SubscribeResult subscribe(uint64_t symbol);
+    instrument_id instrumentID(uint64_t symbol) const {return directory_.find(symbol);}
+    const SymbolDirectory& symbolDirectory() const {return directory_;}
+    uint32_t numShards() const {return static_cast<uint32_t>(shards_.size());}
+    EventSink& shardSink(uint32_t shard) {return shards_[shard]->sink;}
+    const BatchHistogram& batchSizes(uint32_t shard) const {return shards_[shard]->batch_sizes;}
+    // NO_SHARD while the book is being moved
+    uint32_t shardOf(uint64_t instrument) const {
+        if (instrument >= MAX_INSTRUMENTS)
+            return static_cast<uint32_t>(instrument % shards_.size());
+        return routes_[instrument].owner.load();
+    }
+    // busy_ns holds each book's matching time over the last interval, owners its shard
+    static Migration chooseMigration(const std::vector<uint64_t>& busy_ns,
+        const std::vector<uint32_t>& owners, uint32_t num_shards, uint64_t interval_ns);
+    static constexpr uint32_t NO_SHARD = static_cast<uint32_t>(-1);
+private:
+    // producers write pending, keep routes apart from each other and from the load counters
+    struct alignas(64) Route {
+        std::atomic<uint32_t> owner;
+        std::atomic<uint32_t> pending{0}; // producers between reading owner and pushing
+    };
+    // written by the owning shard only
+    struct Load {
+        std::atomic<uint64_t> messages{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+    // book this shard is handing over, it keeps applying the book's commands until then
+    struct Outgoing {
+        instrument_id instrument = NO_INSTRUMENT;
+        uint32_t to = 0;
+        bool producers_done = false;
+        std::size_t until = 0; // ring position the book's last command was queued below
+    };
+    struct Shard {
+        Shard(std::size_t ring_capacity, const EventSink& sink, uint32_t index)
+            : inbound(ring_capacity)
+            , sink(sink)
+            , index(index)
+        {}
+        util::MPSCRing<EngineCommand> inbound;
+        EventSink sink;
+        BatchHistogram batch_sizes;
+        std::vector<std::unique_ptr<OrderBook>> orderbooks; // by instrument id
+        Outgoing outgoing;
+        const uint32_t index;
+        std::thread thread;
+    };
+    void run(Shard& shard, uint32_t cpu);
+    void processBatch(Shard& shard, EngineCommand* batch, std::size_t size);
+    void process(Shard& shard, const EngineCommand& command);
+    void checkMigration(Shard& shard);
+    void runRebalancer();
+    bool applyCreate(Shard& shard, instrument_id instrument, uint32_t ladder_ticks);
+    bool applyRetire(Shard& shard, instrument_id instrument);
+    static OrderBook* findOrderBook(Shard& shard, uint64_t instrument) {
+        return instrument < shard.orderbooks.size() ? shard.orderbooks[instrument].get() : nullptr;
+    }
+    static std::unique_ptr<OrderBook>& slotOf(Shard& shard, instrument_id instrument) {
+        if (shard.orderbooks.size() <= instrument)
+            shard.orderbooks.resize(instrument + 1);
+        return shard.orderbooks[instrument];
+    }
+    static instrument_id toInstrument(uint64_t ticker) {
+        return ticker < NO_INSTRUMENT ? static_cast<instrument_id>(ticker) : NO_INSTRUMENT;
+    }
+    void account(instrument_id instrument, uint64_t messages, uint64_t busy_ns) {
+        if (instrument >= MAX_INSTRUMENTS)
+            return;
+        Load& load = loads_[instrument];
+        load.messages.store(load.messages.load(std::memory_order_relaxed) + messages, std::memory_order_relaxed);
+        load.busy_ns.store(load.busy_ns.load(std::memory_order_relaxed) + busy_ns, std::memory_order_relaxed);
+    }
+    // Registering in pending before re-reading the owner means a shard handing the book
+    // over either sees this producer in pending, or the producer sees the move and waits.
+    void submit(const EngineCommand& command) {
+        if (command.instrument >= MAX_INSTRUMENTS) {
+            shards_[shardOf(command.instrument)]->inbound.push(command);
+            return;
+        }
+        Route& route = routes_[command.instrument];
+        for (;;) {
+            const uint32_t owner = route.owner.load();
+            if (owner == NO_SHARD) {
+                std::this_thread::yield();
+                continue;
+            }
+            route.pending.fetch_add(1);
+            if (route.owner.load() == owner) {
+                shards_[owner]->inbound.push(command);
+                route.pending.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+            route.pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::unique_ptr<Route[]> routes_;
+    std::unique_ptr<Load[]> loads_;
+    std::unique_ptr<OrderBook> handoff_; // the book in flight between two shards
+    std::atomic<bool> migrating_{false};
+    SymbolDirectory directory_;
+    EventSink sink_;
+    std::atomic<bool> running_{false};
+    const bool pin_threads_;
+    std::chrono::milliseconds rebalance_interval_{0};
+    std::thread rebalancer_;
+    std::mutex rebalance_mutex_;
+    std::condition_variable rebalance_cv_;
+    bool stop_rebalancer_ = false;
+    // rebalance() state, under rebalance_mutex_
+    std::vector<uint64_t> last_busy_ns_;
+    std::vector<uint64_t> last_messages_;
+    std::chrono::steady_clock::time_point last_rebalance_;
+};
+
+template<typename EventSink>
+BasicMatchingEngine<EventSink>::BasicMatchingEngine(uint32_t num_shards, EventSink sink,
+std::size_t ring_capacity, bool pin_threads)
+    : routes_(new Route[MAX_INSTRUMENTS])
+    , loads_(new Load[MAX_INSTRUMENTS])
+    , sink_(std::move(sink))
+    , pin_threads_(pin_threads)
+{
+    if (num_shards == 0)
+        throw EngineException("Matching engine needs at least one shard");
+    for (uint32_t i = 0; i < num_shards; ++i)
+        shards_.emplace_back(new Shard(ring_capacity, sink_, i));
+    for (instrument_id i = 0; i < MAX_INSTRUMENTS; ++i)
+        routes_[i].owner.store(i % num_shards, std::memory_order_relaxed);
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::start() {
+    if (running_.exchange(true))
+        return;
+    const uint32_t num_cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t i = 0; i < shards_.size(); ++i) {
+        Shard& shard = *shards_[i];
+        shard.thread = std::thread([this, &shard, cpu = i % num_cpus](){run(shard, cpu);});
+    }
+    {
+        std::lock_guard<std::mutex> lock(rebalance_mutex_);
+        last_rebalance_ = std::chrono::steady_clock::now();
+        stop_rebalancer_ = false;
+    }
+    if (rebalance_interval_.count() > 0 && shards_.size() > 1)
+        rebalancer_ = std::thread([this](){runRebalancer();});
+}
+
+// A move in flight needs both of its shards running, let it land before draining.
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::stop() {
+    if (!running_.load())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(rebalance_mutex_);
+        stop_rebalancer_ = true;
+    }
+    rebalance_cv_.notify_all();
+    if (rebalancer_.joinable())
+        rebalancer_.join();
+    while (migrating_.load())
+        std::this_thread::yield();
+    if (!running_.exchange(false))
+        return;
+    for (uint32_t i = 0; i < shards_.size(); ++i) {
+        if (shards_[i]->thread.joinable())
+            shards_[i]->thread.join();
+        logging::Logger::Log(
+            logging::LogType::Info,
+            util::getLogTimestamp(),
+            "Matching thread", i, "batch sizes", shards_[i]->batch_sizes.toString()
+        );
+    }
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::run(Shard& shard, uint32_t cpu) {
+    if (pin_threads_ && !util::pinThisThread(cpu)) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to pin matching thread to cpu", cpu
+        );
+    }
+    std::array<EngineCommand, MAX_BATCH> batch;
+    for (;;) {
+        std::size_t size = 0;
+        while (size < MAX_BATCH && shard.inbound.tryPop(batch[size]))
+            ++size;
+        if (size > 0) {
+            processBatch(shard, batch.data(), size);
+            continue;
+        }
+        // a book on its way out may have no traffic left to trigger the hand over
+        checkMigration(shard);
+        // the ring is empty, so every command pushed before stop() has been applied
+        if (!running_.load(std::memory_order_acquire)) {
+            if (!shard.inbound.tryPop(batch[0]))
+                return;
+            processBatch(shard, batch.data(), 1);
+            continue;
+        }
+        std::this_thread::yield();
+    }
+}
+
+// Each book's commands keep their arrival order, only commands for different
+// books are reordered. Insertion sort is stable, allocation free and close to
+// linear on bursts that already arrive grouped.
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::processBatch(Shard& shard, EngineCommand* batch, std::size_t size) {
+    using clock = std::chrono::steady_clock;
+    shard.batch_sizes.record(size);
+    for (std::size_t i = 1; i < size; ++i) {
+        const EngineCommand command = batch[i];
+        std::size_t j = i;
+        for (; j > 0 && batch[j - 1].instrument > command.instrument; --j)
+            batch[j] = batch[j - 1];
+        batch[j] = command;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+        if (const OrderBook* orderbook = findOrderBook(shard, batch[i].instrument))
+            orderbook->prefetch(batch[i].price, batch[i].order_id);
+    }
+    shard.sink.onBatchBegin();
+    // one clock read per run of commands for the same book
+    for (std::size_t begin = 0, end = 0; begin < size; begin = end) {
+        const instrument_id instrument = batch[begin].instrument;
+        const auto started = clock::now();
+        uint64_t messages = 0;
+        for (end = begin; end < size && batch[end].instrument == instrument; ++end) {
+            process(shard, batch[end]);
+            // moving a book is not load on it
+            messages += batch[end].type < EngineCommand::Type::migrate;
+        }
+        account(instrument, messages, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock::now() - started).count());
+    }
+    shard.sink.onBatchEnd();
+    checkMigration(shard);
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::process(Shard& shard, const EngineCommand& command) {
+    switch (command.type) {
+    case EngineCommand::Type::create:
+        applyCreate(shard, command.instrument, command.quantity);
+        return;
+    case EngineCommand::Type::retire:
+        applyRetire(shard, command.instrument);
+        return;
+    case EngineCommand::Type::migrate:
+        shard.outgoing = Outgoing();
+        shard.outgoing.instrument = command.instrument;
+        shard.outgoing.to = command.quantity;
+        return;
+    case EngineCommand::Type::adopt:
+        slotOf(shard, command.instrument) = std::move(handoff_);
+        migrating_.store(false);
+        return;
+    default:
+        break;
+    }
+    OrderBook* orderbook = findOrderBook(shard, command.instrument);
+    if (orderbook == nullptr) {
+        shard.sink.onReject(RejectReason::orderbook_not_found, nullptr,
+            command.user_id, command.order_id, command.instrument);
+        return;
+    }
+    const info::OrderCommon common(command.order_id, command.user_id, command.instrument);
+    switch (command.type) {
+    case EngineCommand::Type::add: {
+        ::tradeorder::Order order(command.is_buy_side, nullptr,
+            command.price, command.quantity, common);
+        orderbook->addOrder(order);
+        break;
+    }
+    case EngineCommand::Type::modify:
+        if (command.quantity == 0) {
+            shard.sink.onReject(RejectReason::modification_trivial, nullptr,
+                command.user_id, command.order_id, command.instrument);
+            break;
+        }
+        orderbook->modifyOrder(info::ModifyOrder(command.is_buy_side,
+            nullptr, command.price, command.quantity, common));
+        break;
+    case EngineCommand::Type::cancel:
+        orderbook->cancelOrder(info::CancelOrder(command.order_id,
+            command.user_id, command.instrument, nullptr));
+        break;
+    default:
+        break;
+    }
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::addOrder(const ::tradeorder::Order& order) {
+    submit({EngineCommand::Type::add, order.isBuySide(), order.getCurrQty(), order.getPrice(), order.getOrderID(), order.getUserID(),
+        toInstrument(order.getTicker())});
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::modifyOrder(const info::ModifyOrder& modify_order) {
+    submit({EngineCommand::Type::modify, modify_order.is_buy_side, modify_order.quantity,
+        modify_order.price, modify_order.order_id,
+        modify_order.user_id, toInstrument(modify_order.ticker)});
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::cancelOrder(const info::CancelOrder& cancel_order) {
+    submit({EngineCommand::Type::cancel, 0, 0, 0,
+        cancel_order.order_id, cancel_order.user_id, toInstrument(cancel_order.ticker)});
+}
+
+template<typename EventSink>
+bool BasicMatchingEngine<EventSink>::createOrderBook(uint64_t symbol, uint32_t ladder_ticks) {
+    const instrument_id instrument = directory_.add(symbol);
+    if (instrument >= MAX_INSTRUMENTS) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to create orderbook", util::ShortString(symbol),
+            "more than", MAX_INSTRUMENTS, "instruments"
+        );
+        return false;
+    }
+    if (running_.load()) {
+        submit({EngineCommand::Type::create, 0, ladder_ticks, 0, 0, 0, instrument});
+        return true;
+    }
+    return applyCreate(*shards_[shardOf(instrument)], instrument, ladder_ticks);
+}
+
+template<typename EventSink>
+bool BasicMatchingEngine<EventSink>::retireOrderBook(uint64_t symbol) {
+    const instrument_id instrument = directory_.find(symbol);
+    if (instrument == NO_INSTRUMENT) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to retire orderbook", util::ShortString(symbol),
+            "not found"
+        );
+        return false;
+    }
+    if (running_.load()) {
+        submit({EngineCommand::Type::retire, 0, 0, 0, 0, 0, instrument});
+        return true;
+    }
+    return applyRetire(*shards_[shardOf(instrument)], instrument);
+}
+
+// Stops producers routing to the old owner and queues the move behind everything
+// already on its ring, the old owner finishes it in checkMigration().
+template<typename EventSink>
+bool BasicMatchingEngine<EventSink>::migrateOrderBook(uint64_t symbol, uint32_t shard) {
+    const instrument_id instrument = directory_.find(symbol);
+    if (instrument >= MAX_INSTRUMENTS || shard >= shards_.size())
+        return false;
+    if (migrating_.exchange(true))
+        return false;
+    Route& route = routes_[instrument];
+    const uint32_t from = route.owner.load();
+    if (from == shard) {
+        migrating_.store(false);
+        return false;
+    }
+    if (!running_.load()) {
+        auto& orderbooks = shards_[from]->orderbooks;
+        if (instrument < orderbooks.size())
+            slotOf(*shards_[shard], instrument) = std::move(orderbooks[instrument]);
+        route.owner.store(shard);
+        migrating_.store(false);
+        return true;
+    }
+    route.owner.store(NO_SHARD);
+    shards_[from]->inbound.push({EngineCommand::Type::migrate, 0, shard, 0, 0, 0, instrument});
+    return true;
+}
+
+// Runs on the old owner after each batch. Once no producer is mid submit for the book,
+// every command for it sits below the current enqueue position, and once the ring has
+// been drained past that they have all been applied here. The book then travels on the
+// new owner's ring, which producers only start routing to after it has been queued.
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::checkMigration(Shard& shard) {
+    Outgoing& outgoing = shard.outgoing;
+    if (outgoing.instrument == NO_INSTRUMENT)
+        return;
+    Route& route = routes_[outgoing.instrument];
+    if (!outgoing.producers_done) {
+        if (route.pending.load() != 0)
+            return;
+        outgoing.producers_done = true;
+        outgoing.until = shard.inbound.enqueuePosition();
+    }
+    if (shard.inbound.dequeuePosition() < outgoing.until)
+        return;
+    shard.sink.onHandOff();
+    if (outgoing.instrument < shard.orderbooks.size())
+        handoff_ = std::move(shard.orderbooks[outgoing.instrument]);
+    shards_[outgoing.to]->inbound.push({EngineCommand::Type::adopt, 0, 0, 0, 0, 0,
+        outgoing.instrument});
+    route.owner.store(outgoing.to, std::memory_order_release);
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Moved orderbook", util::ShortString(directory_.symbol(outgoing.instrument)),
+        "instrument id", outgoing.instrument,
+        "from matching thread", shard.index, "to", outgoing.to
+    );
+    outgoing = Outgoing();
+}
+
+template<typename EventSink>
+bool BasicMatchingEngine<EventSink>::rebalance() {
+    std::lock_guard<std::mutex> lock(rebalance_mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t interval_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        now - last_rebalance_).count();
+    last_rebalance_ = now;
+    const std::size_t num_books = std::min<std::size_t>(directory_.size(), MAX_INSTRUMENTS);
+    last_busy_ns_.resize(num_books, 0);
+    last_messages_.resize(num_books, 0);
+    std::vector<uint64_t> busy_ns(num_books), messages(num_books);
+    std::vector<uint32_t> owners(num_books);
+    for (std::size_t i = 0; i < num_books; ++i) {
+        const uint64_t busy = loads_[i].busy_ns.load(std::memory_order_relaxed);
+        const uint64_t count = loads_[i].messages.load(std::memory_order_relaxed);
+        busy_ns[i] = busy - last_busy_ns_[i];
+        messages[i] = count - last_messages_[i];
+        last_busy_ns_[i] = busy;
+        last_messages_[i] = count;
+        owners[i] = routes_[i].owner.load();
+    }
+    if (!running_.load() || migrating_.load())
+        return false;
+    const Migration migration = chooseMigration(busy_ns, owners, numShards(), interval_ns);
+    if (migration.book == NO_INSTRUMENT)
+        return false;
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Rebalancing orderbook", util::ShortString(directory_.symbol(migration.book)),
+        "instrument id", migration.book,
+        "at", messages[migration.book] * 1000000000 / interval_ns, "messages/s",
+        busy_ns[migration.book] * 100 / interval_ns, "% busy, to matching thread", migration.to
+    );
+    return migrateOrderBook(directory_.symbol(migration.book), migration.to);
+}
+
+// Of the busiest shard's books the one carrying closest to half the gap to the idlest
+// shard evens the pair out best. Books carrying the whole gap or more would only swap
+// which shard is the busy one.
+template<typename EventSink>
+typename BasicMatchingEngine<EventSink>::Migration
+BasicMatchingEngine<EventSink>::chooseMigration(const std::vector<uint64_t>& busy_ns,
+const std::vector<uint32_t>& owners, uint32_t num_shards, uint64_t interval_ns) {
+    std::vector<uint64_t> shard_busy_ns(num_shards, 0);
+    for (std::size_t i = 0; i < busy_ns.size(); ++i) {
+        if (owners[i] < num_shards)
+            shard_busy_ns[owners[i]] += busy_ns[i];
+    }
+    const auto hot = std::max_element(shard_busy_ns.begin(), shard_busy_ns.end()) - shard_busy_ns.begin();
+    const auto cold = std::min_element(shard_busy_ns.begin(), shard_busy_ns.end()) - shard_busy_ns.begin();
+    const uint64_t gap = shard_busy_ns[hot] - shard_busy_ns[cold];
+    if (gap == 0 || shard_busy_ns[hot] * 100 < interval_ns * MIN_BUSY_PERCENT
+    || gap * 100 < shard_busy_ns[hot] * MIN_IMBALANCE_PERCENT)
+        return {NO_INSTRUMENT, 0};
+    Migration best{NO_INSTRUMENT, static_cast<uint32_t>(cold)};
+    uint64_t best_distance = gap;
+    for (std::size_t i = 0; i < busy_ns.size(); ++i) {
+        if (owners[i] != static_cast<uint32_t>(hot) || busy_ns[i] == 0 || busy_ns[i] >= gap)
+            continue;
+        const uint64_t twice = 2 * busy_ns[i];
+        const uint64_t distance = twice > gap ? twice - gap : gap - twice;
+        if (distance < best_distance) {
+            best.book = static_cast<instrument_id>(i);
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+template<typename EventSink>
+void BasicMatchingEngine<EventSink>::runRebalancer() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(rebalance_mutex_);
+            if (rebalance_cv_.wait_for(lock, rebalance_interval_, [this](){return stop_rebalancer_;}))
+                return;
+        }
+        rebalance();
+    }
+}
+
+template<typename EventSink>
+typename BasicMatchingEngine<EventSink>::BookLoad
+BasicMatchingEngine<EventSink>::bookLoad(uint64_t symbol) const {
+    const instrument_id instrument = directory_.find(symbol);
+    if (instrument >= MAX_INSTRUMENTS)
+        return {0, 0};
+    return {loads_[instrument].messages.load(std::memory_order_relaxed),
+        loads_[instrument].busy_ns.load(std::memory_order_relaxed)};
+}
+
+template<typename EventSink>
+bool BasicMatchingEngine<EventSink>::applyCreate(Shard& shard, instrument_id instrument, uint32_t ladder_ticks) {
+    if (findOrderBook(shard, instrument) != nullptr) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to create orderbook", util::ShortString(directory_.symbol(instrument)),
+            "already exists"
+        );
+        return false;
+    }
+    slotOf(shard, instrument).reset(new OrderBook(sink_, ladder_ticks));
+    return true;
+}
+
+template<typename EventSink>
+bool BasicMatchingEngine<EventSink>::applyRetire(Shard& shard, instrument_id instrument) {
+    OrderBook* orderbook = findOrderBook(shard, instrument);
+    if (orderbook == nullptr) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to retire orderbook", util::ShortString(directory_.symbol(instrument)),
+            "not found"
+        );
+        return false;
+    }
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Retired orderbook", util::ShortString(directory_.symbol(instrument)),
+        "cancelling", orderbook->numOrders(), "resting orders"
+    );
+    orderbook->retire();
+    shard.orderbooks[instrument].reset();
+    return true;
+}
+
+template<typename EventSink>
+typename BasicMatchingEngine<EventSink>::SubscribeResult
+BasicMatchingEngine<EventSink>::subscribe(uint64_t symbol) {
+    const instrument_id instrument = directory_.find(symbol);
+    const uint32_t owner = instrument == NO_INSTRUMENT ? NO_SHARD : shardOf(instrument);
+    OrderBook* orderbook = owner == NO_SHARD ? nullptr : findOrderBook(*shards_[owner], instrument);
+    if (orderbook == nullptr) {
+        static OrderBook dangler;
+        return {false, dangler};
+    }
+    return {true, *orderbook};
+}
+}
+}
+#endif
@@ -0,0 +1,160 @@
+#ifndef OCCUPANCY_BITMAP_HPP
+#define OCCUPANCY_BITMAP_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace server {
+namespace tradeorder {
+// Hierarchical bitmap over price ladder slots. Level 0 holds one bit per slot, each
+// level above holds one bit per non-empty word of the level below, so finding the
+// next populated slot in either direction is a bit-scan per level (tzcnt/lzcnt)
+// regardless of how sparse the ladder is. The top level is kept to a few words
+// which are scanned directly, four at a time with AVX2 where available.
+class OccupancyBitmap {
+public:
+    static constexpr std::size_t NPOS = static_cast<std::size_t>(-1);
+    static constexpr std::size_t TOP_WORDS = 8;
+    explicit OccupancyBitmap(std::size_t num_bits = 0) {
+        std::size_t bits = num_bits;
+        for (;;) {
+            std::size_t words = (bits + 63) / 64;
+            levels_.emplace_back(words ? words : 1, 0);
+            if (words <= TOP_WORDS)
+                break;
+            bits = words;
+        }
+    }
+    bool test(std::size_t bit) const {
+        return (levels_[0][bit >> 6] >> (bit & 63)) & 1ULL;
+    }
+    void set(std::size_t bit) {
+        for (auto& level : levels_) {
+            uint64_t& word = level[bit >> 6];
+            const bool was_empty = word == 0;
+            word |= 1ULL << (bit & 63);
+            if (!was_empty)
+                return;
+            bit >>= 6;
+        }
+    }
+    void clear(std::size_t bit) {
+        for (auto& level : levels_) {
+            uint64_t& word = level[bit >> 6];
+            word &= ~(1ULL << (bit & 63));
+            if (word != 0)
+                return;
+            bit >>= 6;
+        }
+    }
+    bool empty() const {return firstNonZeroWord(levels_.back(), 0) == NPOS;}
+    // smallest set bit >= from, or NPOS
+    std::size_t nextSet(std::size_t from) const;
+    // largest set bit <= from, or NPOS
+    std::size_t prevSet(std::size_t from) const;
+private:
+    static std::size_t lowestBit(uint64_t word) {return __builtin_ctzll(word);}
+    static std::size_t highestBit(uint64_t word) {return 63 - __builtin_clzll(word);}
+    static std::size_t firstNonZeroWord(const std::vector<uint64_t>& words, std::size_t from);
+    static std::size_t lastNonZeroWord(const std::vector<uint64_t>& words, std::size_t from);
+    std::size_t descendLowest(std::size_t level, std::size_t bit) const;
+    std::size_t descendHighest(std::size_t level, std::size_t bit) const;
+
+    std::vector<std::vector<uint64_t>> levels_;
+};
+
+inline std::size_t OccupancyBitmap::nextSet(std::size_t from) const {
+    std::size_t idx = from;
+    for (std::size_t level = 0; level < levels_.size(); ++level) {
+        const auto& words = levels_[level];
+        const std::size_t word_idx = idx >> 6;
+        if (word_idx >= words.size())
+            return NPOS;
+        const uint64_t masked = words[word_idx] & (~0ULL << (idx & 63));
+        if (masked != 0)
+            return descendLowest(level, (word_idx << 6) | lowestBit(masked));
+        if (level + 1 == levels_.size()) {
+            const std::size_t next_word = firstNonZeroWord(words, word_idx + 1);
+            if (next_word == NPOS)
+                return NPOS;
+            return descendLowest(level, (next_word << 6) | lowestBit(words[next_word]));
+        }
+        idx = word_idx + 1;
+    }
+    return NPOS;
+}
+
+inline std::size_t OccupancyBitmap::prevSet(std::size_t from) const {
+    std::size_t idx = from;
+    for (std::size_t level = 0; level < levels_.size(); ++level) {
+        const auto& words = levels_[level];
+        const std::size_t word_idx = idx >> 6;
+        const uint64_t masked = words[word_idx] & (~0ULL >> (63 - (idx & 63)));
+        if (masked != 0)
+            return descendHighest(level, (word_idx << 6) | highestBit(masked));
+        if (word_idx == 0)
+            return NPOS;
+        if (level + 1 == levels_.size()) {
+            const std::size_t prev_word = lastNonZeroWord(words, word_idx - 1);
+            if (prev_word == NPOS)
+                return NPOS;
+            return descendHighest(level, (prev_word << 6) | highestBit(words[prev_word]));
+        }
+        idx = word_idx - 1;
+    }
+    return NPOS;
+}
+
+// bit found at a summary level: walk back down picking the extreme bit of each word
+inline std::size_t OccupancyBitmap::descendLowest(std::size_t level, std::size_t bit) const {
+    while (level-- > 0)
+        bit = (bit << 6) | lowestBit(levels_[level][bit]);
+    return bit;
+}
+
+inline std::size_t OccupancyBitmap::descendHighest(std::size_t level, std::size_t bit) const {
+    while (level-- > 0)
+        bit = (bit << 6) | highestBit(levels_[level][bit]);
+    return bit;
+}
+
+inline std::size_t OccupancyBitmap::firstNonZeroWord(const std::vector<uint64_t>& words, std::size_t from) {
+    std::size_t idx = from;
+    #ifdef __AVX2__
+    for (; idx + 4 <= words.size(); idx += 4) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words.data() + idx));
+        if (!_mm256_testz_si256(chunk, chunk))
+            break;
+    }
+    #endif
+    for (; idx < words.size(); ++idx) {
+        if (words[idx] != 0)
+            return idx;
+    }
+    return NPOS;
+}
+
+inline std::size_t OccupancyBitmap::lastNonZeroWord(const std::vector<uint64_t>& words, std::size_t from) {
+    std::size_t end = from + 1;
+    #ifdef __AVX2__
+    for (; end >= 4; end -= 4) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words.data() + end - 4));
+        if (!_mm256_testz_si256(chunk, chunk))
+            break;
+    }
+    #endif
+    for (; end > 0; --end) {
+        if (words[end - 1] != 0)
+            return end - 1;
+    }
+    return NPOS;
+}
+
+}
+}
+
+#endif
@@ -7,26 +7,16 @@
 #include <iostream>
 #include <utility>
 #include <mutex>
-#ifndef TEST_BUILD
-#include "orderentrystreamconnection.hpp"
-#include "marketdatadispatcher.hpp"
-#else 
-namespace rpc {class MarketDataDispatcher;}
-#endif
+
 #include "logger.hpp"
+#include "nullmutex.hpp"
 #include "exception.hpp"
+#include "eventsink.hpp"
 #include "fifomatching.hpp"
 #include "order.hpp"
 #include "limit.hpp"
-
-static constexpr uint8_t UNKNOWN = 0;
-static constexpr uint8_t ORDER_NOT_FOUND = 1;
-static constexpr uint8_t ORDER_ID_ALREADY_PRESENT = 2;
-static constexpr uint8_t ORDERBOOK_NOT_FOUND = 3;
-static constexpr uint8_t TICKER_NOT_FOUND = 4;
-static constexpr uint8_t MODIFY_WRONG_SIDE = 5;
-static constexpr uint8_t MODIFICATION_TRIVIAL = 6;
-static constexpr uint8_t WRONG_USER_ID = 7;
+#include "limitbook.hpp"
+#include "priceladder.hpp"
 
 namespace server {
 namespace tradeorder {
@@ -34,118 +24,398 @@ using namespace info;
 using price = uint64_t;
 using order_id = uint64_t;
 using Order = ::tradeorder::Order;
-using askbook = std::map<price, Level>;
-using bidbook = std::map<price, Level, std::greater<price>>;
-using limitbook = std::unordered_map<order_id, server::tradeorder::Limit>;
-using MatchResult = server::matching::MatchResult;
-using GetOrderResult = std::pair<bool, Order&>;
-#ifndef TEST_BUILD
-using Rejection = orderentry::OrderEntryRejection::RejectionReason; 
-using MDResponse = orderentry::MarketDataResponse;
-#else
-enum Rejection {
-    UNKNOWN = 1,
-    ORDER_NOT_FOUND = 1,
-    ORDER_ID_ALREADY_PRESENT = 2,
-    ORDERBOOK_NOT_FOUND = 3,
-    TICKER_NOT_FOUND = 4,
-    MODIFY_WRONG_SIDE = 5,
-    MODIFICATION_TRIVIAL = 6,
-    WRONG_USER_ID = 7,
-};
-#endif
+using askbook = PriceLadder<std::less<price>>;
+using bidbook = PriceLadder<std::greater<price>>;
+using limitbook = LimitBook;
+using GetOrderResult = std::pair<bool, Order>;
 
-class OrderBook {
+// EventSink receives every ack, fill and book change, see eventsink.hpp. Mutex
+// guards the book against concurrent callers, books owned by a single matching
+// thread use util::NullMutex.
+template<typename EventSink, typename Mutex = std::mutex>
+class BasicOrderBook {
 public:
-    OrderBook(rpc::MarketDataDispatcher* md_dispatch);
-    OrderBook(const OrderBook& orderbook);
-    OrderBook() = default;
+    BasicOrderBook(EventSink sink = EventSink(), uint32_t ladder_ticks = 0);
+    // books are owned in place, copying one would silently drop its orders
+    BasicOrderBook(const BasicOrderBook&) = delete;
+    BasicOrderBook& operator=(const BasicOrderBook&) = delete;
     void addOrder(Order& order);
     void modifyOrder(const info::ModifyOrder& modify_order);
     void cancelOrder(const info::CancelOrder& cancel_order);
+    // cancels every resting order, anything reaching the book afterwards is rejected
+    void retire();
     GetOrderResult getOrder(uint64_t order_id);
+    const Level* getLevel(bool is_buy_side, uint64_t price) const {
+        return is_buy_side ? bids_.find(price) : asks_.find(price);
+    }
     uint64_t numOrders() const {return limitorders_.size();}
     uint64_t numLevels() const {return asks_.size() + bids_.size();}
-    rpc::MarketDataDispatcher* getMDDispatcher() const {return md_dispatch_;}
+    uint32_t ladderTicks() const {return asks_.ladderTicks();}
+    uint64_t limitPoolCapacity() const {return limitorders_.poolCapacity();}
+    uint64_t levelsReused() const {return asks_.levelsReused() + bids_.levelsReused();}
+    uint64_t levelsAllocated() const {return asks_.levelsAllocated() + bids_.levelsAllocated();}
+    // warms the index entry and both ladder slots the next command will touch,
+    // takes no lock so only for books owned by the calling thread
+    void prefetch(uint64_t price, uint64_t order_id) const {
+        limitorders_.prefetch(order_id);
+        asks_.prefetch(price);
+        bids_.prefetch(price);
+    }
+    EventSink& sink() {return sink_;}
+    const EventSink& sink() const {return sink_;}
 private:
-    template<typename BookToMatchOn, typename BookToAddTo> 
+    template<typename BookToMatchOn, typename BookToAddTo>
     void addOrder(Order& order, BookToMatchOn& match_book, BookToAddTo& add_book);
+    template<typename BookToMatchOn, typename BookToAddTo>
+    void replaceOrder(limit_index idx, Order& amended, BookToMatchOn& match_book, BookToAddTo& add_book);
+    void replaceOrder(limit_index idx, const info::ModifyOrder& modify_order);
     template<typename Book> void placeOrderInBook(Order& order, Book& book, bool is_buy_side);
-    template<typename Book> Level& getSideLevel(const uint64_t price, Book& sidebook);
-    template<typename OrderType> void sendRejection(Rejection rejection, const OrderType& order);
+    template<typename Book> void matchOrder(Order& order, Book& match_book);
+    template<typename Book> void cancelSide(Book& book);
+    template<typename OrderType> void sendRejection(RejectReason rejection, const OrderType& order);
     void processModifyError(uint8_t error_flags, const ModifyOrder& order);
-    void communicateMatchResults(MatchResult& match_result, const Order& order) const;
     bool possibleMatches(const askbook& book, const Order& order) const;
     bool possibleMatches(const bidbook& book, const Order& order) const;
-    bool modifyOrderTrivial(const info::ModifyOrder& modify_order, const Order& order);
+    bool modifyOrderTrivial(const info::ModifyOrder& modify_order, const Limit& limit);
     void placeLimitInBookLevel(Level& level, Order& order);
-    void sendOrderAddedToDispatcher(const Order& order);
-    void sendOrderCancelledToDispatcher(const info::CancelOrder& cancel_order);
-    void sendOrderModifiedToDispatcher(const info::ModifyOrder& modify_order);
+    void linkLimitAtTail(Level& level, limit_index idx);
+    void unlinkLimit(Limit& limit);
+    Level& restingLevel(const Limit& lim);
     bool isTailOrder(const Limit& lim) const;
     bool isHeadOrder(const Limit& lim) const;
     bool isHeadAndTail(const Limit& lim) const;
     bool isInMiddleOfLevel(const Limit& lim) const;
-    
+
     uint64_t ticker_;
     askbook asks_;
     bidbook bids_;
-    std::unordered_map<order_id, Limit> limitorders_;
-    std::mutex orderbook_mutex_;
-    rpc::MarketDataDispatcher* md_dispatch_;
-    #ifndef TEST_BUILD
-    static thread_local orderentry::OrderEntryResponse orderfill_ack;
-    static thread_local MDResponse orderfill_data;
-    static thread_local MDResponse neworder_data;
-    static thread_local MDResponse modorder_data;
-    static thread_local MDResponse cancelorder_data;
-    #endif
+    limitbook limitorders_;
+    Mutex orderbook_mutex_;
+    EventSink sink_;
+    bool retired_ = false;
 };
 
-template<typename OrderType>
-inline void OrderBook::sendRejection(Rejection rejection, const OrderType& order) {
-    #ifndef TEST_BUILD
-    order.connection->sendRejection(rejection, order.user_id, order.order_id, order.ticker);
-    #endif
-}
+template<typename EventSink, typename Mutex>
+BasicOrderBook<EventSink, Mutex>::BasicOrderBook(EventSink sink, uint32_t ladder_ticks)
+    : asks_(ladder_ticks)
+    , bids_(ladder_ticks)
+    , sink_(std::move(sink))
+{}
 
-template<typename Book>
-inline Level& OrderBook::getSideLevel(const uint64_t price, Book& sidebook) {
-    auto lvlitr = sidebook.find(price);
-    if (lvlitr == sidebook.end()) {
-        auto ret = sidebook.emplace(price, Level(price));
-        if (!ret.second) {
-            logging::Logger::Log(
-                logging::LogType::Error,
-                util::getLogTimestamp(),
-                "Failed to emplace price level", price,
-                "in orderbook", ticker_
-            );
-            throw EngineException("Unable to emplace price level in orderbook");
-        }
-        lvlitr = ret.first;
+template<typename EventSink, typename Mutex>
+void BasicOrderBook<EventSink, Mutex>::addOrder(Order& order) {
+    std::lock_guard<Mutex> lock(orderbook_mutex_);
+    if (retired_) {
+        sink_.onReject(RejectReason::orderbook_not_found, order.connection_,
+            order.getUserID(), order.getOrderID(), order.getTicker());
+        return;
+    }
+    if (limitorders_.find(order.getOrderID()) != NO_LIMIT) {
+        sink_.onReject(RejectReason::order_id_already_present, order.connection_,
+            order.getUserID(), order.getOrderID(), order.getTicker());
+        return;
     }
-    return lvlitr->second;
+    switch(order.isBuySide()) {
+        case true:
+            addOrder(order, asks_, bids_);
+            break;
+        case false:
+            addOrder(order, bids_, asks_);
+            break;
+    }
+}
+
+template<typename EventSink, typename Mutex>
+template<typename OrderType>
+inline void BasicOrderBook<EventSink, Mutex>::sendRejection(RejectReason rejection, const OrderType& order) {
+    sink_.onReject(rejection, order.connection, order.user_id, order.order_id, order.ticker);
 }
-template<typename BookToMatchOn, typename BookToAddTo> 
-void OrderBook::addOrder(Order& order, BookToMatchOn& match_book, BookToAddTo& add_book) {
+
+template<typename EventSink, typename Mutex>
+template<typename BookToMatchOn, typename BookToAddTo>
+void BasicOrderBook<EventSink, Mutex>::addOrder(Order& order, BookToMatchOn& match_book, BookToAddTo& add_book) {
     if (possibleMatches(match_book, order)) {
-        auto match_result = matching::FIFOMatcher::FIFOMatch(order, match_book, limitorders_);
-        communicateMatchResults(match_result, order);
+        matchOrder(order, match_book);
         if (order.getCurrQty() == 0)
             return;
     }
     placeOrderInBook(order, add_book, order.isBuySide());
-    sendOrderAddedToDispatcher(order);
+    sink_.onAdd(order);
+}
+
+// fills stream straight from the matcher into the sink
+template<typename EventSink, typename Mutex>
+template<typename Book>
+inline void BasicOrderBook<EventSink, Mutex>::matchOrder(Order& order, Book& match_book) {
+    matching::FillStream fills([this, &order](const info::Fill& fill) {sink_.onFill(fill, order);});
+    matching::FIFOMatcher::FIFOMatch(order, match_book, limitorders_, fills);
 }
 
+template<typename EventSink, typename Mutex>
 template<typename Book>
-inline void OrderBook::placeOrderInBook(Order& order, Book& book, bool is_buy_side) {
-    Level& level = getSideLevel(order.getPrice(), book);
+inline void BasicOrderBook<EventSink, Mutex>::placeOrderInBook(Order& order, Book& book, bool is_buy_side) {
+    Level& level = book.getLevel(order.getPrice());
     level.is_buy_side = is_buy_side;
     placeLimitInBookLevel(level, order);
 }
 
+// these will be inlined (hopefully) and are just for readability
+template<typename EventSink, typename Mutex>
+inline void BasicOrderBook<EventSink, Mutex>::placeLimitInBookLevel(Level& level, ::tradeorder::Order& order) {
+    const limit_index idx = limitorders_.emplace(order);
+    if (idx == NO_LIMIT) {
+        logging::Logger::Log(
+            logging::LogType::Error,
+            util::getLogTimestamp(),
+            "Failed to emplace order in limitbook", util::ShortString(order.getTicker()),
+            "Order ID", order.getOrderID()
+        );
+        throw EngineException(
+            "Unable to emplace new order in limitorder book, Book ID: "
+            + std::to_string(ticker_) + " Order ID: " + std::to_string(order.getOrderID())
+        );
+    }
+    linkLimitAtTail(level, idx);
+}
+
+template<typename EventSink, typename Mutex>
+inline void BasicOrderBook<EventSink, Mutex>::linkLimitAtTail(Level& level, limit_index idx) {
+    level.addToLevel(limitorders_[idx].quantity);
+    if (level.head == NO_LIMIT) {
+        level.head = idx;
+        level.tail = idx;
+    }
+    else {
+        limit_index limit_temp = level.tail;
+        level.tail = idx;
+        limitorders_[idx].prev_limit = limit_temp;
+        limitorders_[limit_temp].next_limit = idx;
+    }
+}
+
+// takes the limit out of its level's queue, erasing the level if it was the last order
+template<typename EventSink, typename Mutex>
+inline void BasicOrderBook<EventSink, Mutex>::unlinkLimit(Limit& limit) {
+    Level& level = restingLevel(limit);
+    level.removeFromLevel(limit.quantity);
+    if (isInMiddleOfLevel(limit)) {
+        limitorders_[limit.next_limit].prev_limit = limit.prev_limit;
+        limitorders_[limit.prev_limit].next_limit = limit.next_limit;
+    }
+    else if (isHeadOrder(limit)) {
+        level.head = limit.next_limit;
+        limitorders_[limit.next_limit].prev_limit = NO_LIMIT;
+    }
+    else if (isTailOrder(limit)) {
+        level.tail = limit.prev_limit;
+        limitorders_[limit.prev_limit].next_limit = NO_LIMIT;
+    }
+    else if (isHeadAndTail(limit)) {
+        if (limit.is_buy_side) // if head and tail, its last order in level, so erase level
+            bids_.erase(level);
+        else
+            asks_.erase(level);
+    }
+    limit.next_limit = NO_LIMIT;
+    limit.prev_limit = NO_LIMIT;
+}
+
+template<typename EventSink, typename Mutex>
+inline bool BasicOrderBook<EventSink, Mutex>::possibleMatches(const askbook& book, const ::tradeorder::Order& order) const {
+    return !book.empty() && book.best()->price <= order.getPrice();
+}
+
+template<typename EventSink, typename Mutex>
+inline bool BasicOrderBook<EventSink, Mutex>::possibleMatches(const bidbook& book, const ::tradeorder::Order& order) const {
+    return !book.empty() && book.best()->price >= order.getPrice();
+}
+
+template<typename EventSink, typename Mutex>
+void BasicOrderBook<EventSink, Mutex>::modifyOrder(const ModifyOrder& modify_order) {
+    std::lock_guard<Mutex> lock(orderbook_mutex_);
+    using namespace info;
+    if (retired_) {
+        sendRejection(RejectReason::orderbook_not_found, modify_order);
+        return;
+    }
+    const limit_index idx = limitorders_.find(modify_order.order_id);
+    if (idx == NO_LIMIT) {
+        sendRejection(RejectReason::order_not_found, modify_order);
+        return;
+    }
+    auto& limit = limitorders_[idx];
+    uint8_t error_flags = 0;
+    error_flags |= (limit.is_buy_side != modify_order.is_buy_side) << 1;
+    error_flags |= (limitorders_.info(idx).user_id != modify_order.user_id) << 2;
+    error_flags |= modifyOrderTrivial(modify_order, limit) << 3;
+    if (error_flags) {
+        processModifyError(error_flags, modify_order);
+        return;
+    }
+    if (modify_order.price == limit.price) {
+        Level& level = restingLevel(limit);
+        level.total_quantity -= limit.quantity;
+        limit.quantity = modify_order.quantity;
+        level.total_quantity += limit.quantity;
+        sink_.onModify(modify_order);
+        return;
+    }
+    replaceOrder(idx, modify_order);
+}
+
+// price change: the node leaves its level, may trade at the new price and
+// rests what is left at the back of the new level, keeping its pool slot
+template<typename EventSink, typename Mutex>
+void BasicOrderBook<EventSink, Mutex>::replaceOrder(limit_index idx, const ModifyOrder& modify_order) {
+    Limit& limit = limitorders_[idx];
+    unlinkLimit(limit);
+    limit.price = modify_order.price;
+    limit.quantity = modify_order.quantity;
+    LimitInfo& limit_info = limitorders_.info(idx);
+    limit_info.connection = modify_order.connection;
+    limit_info.initial_quantity = modify_order.quantity;
+    sink_.onReplace(modify_order);
+    Order amended(modify_order);
+    if (amended.isBuySide())
+        replaceOrder(idx, amended, asks_, bids_);
+    else
+        replaceOrder(idx, amended, bids_, asks_);
+}
+
+template<typename EventSink, typename Mutex>
+template<typename BookToMatchOn, typename BookToAddTo>
+void BasicOrderBook<EventSink, Mutex>::replaceOrder(limit_index idx, Order& amended, BookToMatchOn& match_book, BookToAddTo& add_book) {
+    if (possibleMatches(match_book, amended)) {
+        matchOrder(amended, match_book);
+        if (amended.getCurrQty() == 0) {
+            limitorders_.erase(idx);
+            return;
+        }
+    }
+    limitorders_[idx].quantity = amended.getCurrQty();
+    Level& level = add_book.getLevel(amended.getPrice());
+    level.is_buy_side = amended.isBuySide();
+    linkLimitAtTail(level, idx);
+}
+
+template<typename EventSink, typename Mutex>
+inline void BasicOrderBook<EventSink, Mutex>::processModifyError(uint8_t error_flags, const ModifyOrder& order) {
+    bool wrong_side = (error_flags >> 1) & 1U;
+    if (wrong_side)
+        sendRejection(RejectReason::modify_wrong_side, order);
+    bool wrong_userid = (error_flags >> 2) & 1U;
+    if (wrong_userid)
+        sendRejection(RejectReason::wrong_user_id, order);
+    bool trivial_modify = (error_flags >> 3) & 1U;
+    if (trivial_modify)
+        sendRejection(RejectReason::modification_trivial, order);
+}
+
+template<typename EventSink, typename Mutex>
+void BasicOrderBook<EventSink, Mutex>::cancelOrder(const info::CancelOrder& cancel_order) {
+    std::lock_guard<Mutex> lock(orderbook_mutex_);
+    if (retired_) {
+        sendRejection(RejectReason::orderbook_not_found, cancel_order);
+        return;
+    }
+    const limit_index idx = limitorders_.find(cancel_order.order_id);
+    if (idx == NO_LIMIT) {
+        sendRejection(RejectReason::order_not_found, cancel_order);
+        return;
+    }
+    if (limitorders_.info(idx).user_id != cancel_order.user_id) {
+        sendRejection(RejectReason::wrong_user_id, cancel_order);
+        return;
+    }
+    unlinkLimit(limitorders_[idx]);
+    limitorders_.erase(idx);
+    sink_.onCancel(cancel_order);
+}
+
+// callers still holding the book after it is unrouted are rejected rather than
+// left trading against a book nobody can see
+template<typename EventSink, typename Mutex>
+void BasicOrderBook<EventSink, Mutex>::retire() {
+    std::lock_guard<Mutex> lock(orderbook_mutex_);
+    retired_ = true;
+    cancelSide(asks_);
+    cancelSide(bids_);
+}
+
+// best level first, each level front to back
+template<typename EventSink, typename Mutex>
+template<typename Book>
+void BasicOrderBook<EventSink, Mutex>::cancelSide(Book& book) {
+    while (!book.empty()) {
+        const limit_index idx = book.best()->head;
+        Limit& limit = limitorders_[idx];
+        const LimitInfo& limit_info = limitorders_.info(idx);
+        const info::CancelOrder cancel(limit.order_id, limit_info.user_id,
+            limit_info.ticker, limit_info.connection);
+        unlinkLimit(limit);
+        limitorders_.erase(idx);
+        sink_.onCancel(cancel);
+    }
+}
+
+// limits only carry their price, the level is looked up on the side they rest on
+template<typename EventSink, typename Mutex>
+inline Level& BasicOrderBook<EventSink, Mutex>::restingLevel(const Limit& lim) {
+    Level* level = lim.is_buy_side ? bids_.find(lim.price) : asks_.find(lim.price);
+    if (level == nullptr) {
+        throw EngineException(
+            "Resting order without a level, Book ID: " + std::to_string(ticker_)
+            + " Order ID: " + std::to_string(lim.order_id)
+        );
+    }
+    return *level;
+}
+
+template<typename EventSink, typename Mutex>
+inline bool BasicOrderBook<EventSink, Mutex>::isTailOrder(const Limit& lim) const {
+    return lim.next_limit == NO_LIMIT && lim.prev_limit != NO_LIMIT;
+}
+
+template<typename EventSink, typename Mutex>
+inline bool BasicOrderBook<EventSink, Mutex>::isHeadOrder(const Limit& lim) const {
+    return lim.prev_limit == NO_LIMIT && lim.next_limit != NO_LIMIT;
+}
+
+template<typename EventSink, typename Mutex>
+inline bool BasicOrderBook<EventSink, Mutex>::isHeadAndTail(const Limit& lim) const {
+    return lim.next_limit == NO_LIMIT && lim.prev_limit == NO_LIMIT;
+}
+
+template<typename EventSink, typename Mutex>
+inline bool BasicOrderBook<EventSink, Mutex>::isInMiddleOfLevel(const Limit& lim) const {
+    return lim.next_limit != NO_LIMIT && lim.prev_limit != NO_LIMIT;
+}
+
+template<typename EventSink, typename Mutex>
+bool BasicOrderBook<EventSink, Mutex>::modifyOrderTrivial(const info::ModifyOrder& modify_order, const Limit& limit) {
+    return modify_order.price == limit.price && modify_order.quantity == limit.quantity;
+}
+
+template<typename EventSink, typename Mutex>
+GetOrderResult BasicOrderBook<EventSink, Mutex>::getOrder(uint64_t order_id) {
+    const limit_index idx = limitorders_.find(order_id);
+    if (idx == NO_LIMIT) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to find order with ID:", order_id
+        );
+        ::tradeorder::Order dangler;
+        return {false, dangler};
+    }
+    logging::Logger::Log(
+        logging::LogType::Debug,
+        util::getLogTimestamp(),
+        "Successfully found order with ID:", order_id
+    );
+    return {true, limitorders_.toOrder(idx)};
+}
+
 }
 }
 
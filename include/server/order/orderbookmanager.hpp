@@ -1,55 +1,243 @@
 #ifndef ORDERBOOK_MANAGER_HPP
 #define ORDERBOOK_MANAGER_HPP
 
-#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <cstring>
 #include <thread>
 #include <utility>
-#include <shared_mutex>
 
-#ifndef TEST_BUILD
-#include "marketdatadispatcher.hpp"
-#else
-namespace rpc {class MarketDataDispatcher;}
-struct Rejection {Rejection(const uint8_t&){}};
-#endif
 #include "orderbook.hpp"
+#include "eventsink.hpp"
+#include "symboldirectory.hpp"
 #include "logger.hpp"
 
 namespace server {
 namespace tradeorder {
-using SubscribeResult = std::pair<bool, OrderBook&>;
 using order_id = uint64_t; using ticker = uint64_t;
-class OrderBookManager {
+// Every book created by the manager gets a copy of its sink.
+// Books are created by symbol and given a dense instrument id by the SymbolDirectory,
+// orders carry that id in place of a ticker. Routing goes through an immutable
+// RoutingTable, an array of book pointers indexed by instrument id, and creating or
+// retiring a book publishes a new table, RCU style, with a single atomic store.
+// Routing threads never lock and never see a table change under them. Books and
+// old tables are kept alive until clearBooks(), as a reader may still hold them.
+template<typename EventSink>
+class BasicOrderBookManager {
 public:
-    OrderBookManager(rpc::MarketDataDispatcher* md_dispatcher);
+    using OrderBook = BasicOrderBook<EventSink>;
+    using SubscribeResult = std::pair<bool, OrderBook&>;
+    BasicOrderBookManager(EventSink sink = EventSink());
     static void addOrder(::tradeorder::Order& order);
     static void modifyOrder(const info::ModifyOrder& modify_order);
     static void cancelOrder(const info::CancelOrder& cancel_order);
-    static bool createOrderBook(const uint64_t ticker);
-    static bool createOrderBook(const std::string& ticker);
-    static SubscribeResult subscribe(const uint64_t ticker);
-    static SubscribeResult subscribe(const std::string& ticker);
-    static uint64_t numOrderBooks() {return orderbooks_.size();}
-    static void clearBooks() {OrderBookManager::orderbooks_.clear();}
+    static bool createOrderBook(const uint64_t symbol, uint32_t ladder_ticks = 0);
+    static bool createOrderBook(const std::string& symbol, uint32_t ladder_ticks = 0);
+    // stops routing to the book and cancels its resting orders, reporting each to the
+    // sink, callers still holding the book get orderbook_not_found for new orders
+    static bool retireOrderBook(const uint64_t symbol);
+    static SubscribeResult subscribe(const uint64_t symbol);
+    static SubscribeResult subscribe(const std::string& symbol);
+    static instrument_id instrumentID(const uint64_t symbol) {return directory_.find(symbol);}
+    static instrument_id instrumentID(const std::string& symbol) {
+        return directory_.find(convertStrToTicker(symbol));
+    }
+    static const SymbolDirectory& symbolDirectory() {return directory_;}
+    static uint64_t numOrderBooks() {return routingTable()->live_books;}
+    // not safe while other threads are routing orders
+    static void clearBooks();
 private:
-    static rpc::MarketDataDispatcher* marketdata_dispatcher_;
+    struct RoutingTable {
+        std::vector<OrderBook*> books; // by instrument id, nullptr if not live
+        uint64_t live_books = 0;
+    };
+    static const RoutingTable* routingTable() {
+        return routing_table_.load(std::memory_order_acquire);
+    }
+    static OrderBook* findOrderBook(const uint64_t instrument);
+    static void publish(std::unique_ptr<RoutingTable> table);
     static ticker convertStrToTicker(const std::string& input);
-    static std::unordered_map<ticker, OrderBook> orderbooks_;
     template<typename OrderType>
-    static void sendRejection(Rejection rejection, const OrderType& order);
+    static void sendRejection(RejectReason rejection, const OrderType& order);
+
+    static inline EventSink sink_;
+    static inline SymbolDirectory directory_;
+    static inline const RoutingTable empty_table_{};
+    static inline std::atomic<const RoutingTable*> routing_table_{&empty_table_};
+    static inline std::mutex admin_mutex_; // serialises writers only
+    static inline std::vector<std::unique_ptr<OrderBook>> orderbooks_;
+    static inline std::vector<std::unique_ptr<const RoutingTable>> tables_;
 };
 
+template<typename EventSink>
+BasicOrderBookManager<EventSink>::BasicOrderBookManager(EventSink sink) {
+    sink_ = std::move(sink);
+}
+
+template<typename EventSink>
+inline typename BasicOrderBookManager<EventSink>::OrderBook*
+BasicOrderBookManager<EventSink>::findOrderBook(const uint64_t instrument) {
+    const RoutingTable* table = routingTable();
+    return instrument < table->books.size() ? table->books[instrument] : nullptr;
+}
+
+template<typename EventSink>
+void BasicOrderBookManager<EventSink>::publish(std::unique_ptr<RoutingTable> table) {
+    routing_table_.store(table.get(), std::memory_order_release);
+    tables_.push_back(std::move(table));
+}
+
+template<typename EventSink>
 template<typename OrderType>
-inline void OrderBookManager::sendRejection(Rejection rejection, const OrderType& order) {
-    #ifndef TEST_BUILD
-    order.connection->sendRejection(
-        rejection,
-        order.user_id,
-        order.order_id,
-        order.ticker
+inline void BasicOrderBookManager<EventSink>::sendRejection(RejectReason rejection, const OrderType& order) {
+    sink_.onReject(rejection, order.connection, order.user_id, order.order_id, order.ticker);
+}
+
+template<typename EventSink>
+void BasicOrderBookManager<EventSink>::addOrder(::tradeorder::Order& order) {
+    OrderBook* orderbook = findOrderBook(order.getTicker());
+    if (orderbook == nullptr) {
+        sink_.onReject(RejectReason::orderbook_not_found, order.connection_,
+            order.getUserID(), order.getOrderID(), order.getTicker());
+        return;
+    }
+    orderbook->addOrder(order);
+}
+
+template<typename EventSink>
+void BasicOrderBookManager<EventSink>::modifyOrder(const info::ModifyOrder& modify_order) {
+    if (modify_order.quantity == 0) {
+        sendRejection(RejectReason::modification_trivial, modify_order);
+        return;
+    }
+    OrderBook* orderbook = findOrderBook(modify_order.ticker);
+    if (orderbook == nullptr) {
+        sendRejection(RejectReason::orderbook_not_found, modify_order);
+        return;
+    }
+    orderbook->modifyOrder(modify_order);
+}
+
+template<typename EventSink>
+void BasicOrderBookManager<EventSink>::cancelOrder(const info::CancelOrder& cancel_order) {
+    OrderBook* orderbook = findOrderBook(cancel_order.ticker);
+    if (orderbook == nullptr) {
+        sendRejection(RejectReason::orderbook_not_found, cancel_order);
+        return;
+    }
+    orderbook->cancelOrder(cancel_order);
+}
+
+template<typename EventSink>
+bool BasicOrderBookManager<EventSink>::createOrderBook(const uint64_t symbol, uint32_t ladder_ticks) {
+    std::lock_guard<std::mutex> lock(admin_mutex_);
+    const RoutingTable* current = routingTable();
+    const instrument_id instrument = directory_.add(symbol);
+    if (instrument < current->books.size() && current->books[instrument] != nullptr) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to create orderbook", util::ShortString(symbol),
+            "already exists"
+        );
+        return false;
+    }
+    orderbooks_.emplace_back(new OrderBook(sink_, ladder_ticks));
+    std::unique_ptr<RoutingTable> table(new RoutingTable(*current));
+    if (table->books.size() <= instrument)
+        table->books.resize(instrument + 1, nullptr);
+    table->books[instrument] = orderbooks_.back().get();
+    ++table->live_books;
+    publish(std::move(table));
+    logging::Logger::Log(
+        logging::LogType::Debug,
+        util::getLogTimestamp(),
+        "Successfully created orderbook", util::ShortString(symbol),
+        "instrument id", instrument
+    );
+    return true;
+}
+
+template<typename EventSink>
+bool BasicOrderBookManager<EventSink>::retireOrderBook(const uint64_t symbol) {
+    std::lock_guard<std::mutex> lock(admin_mutex_);
+    const RoutingTable* current = routingTable();
+    const instrument_id instrument = directory_.find(symbol);
+    OrderBook* orderbook = findOrderBook(instrument);
+    if (orderbook == nullptr) {
+        logging::Logger::Log(
+            logging::LogType::Warning,
+            util::getLogTimestamp(),
+            "Failed to retire orderbook", util::ShortString(symbol),
+            "not found"
+        );
+        return false;
+    }
+    std::unique_ptr<RoutingTable> table(new RoutingTable(*current));
+    table->books[instrument] = nullptr;
+    --table->live_books;
+    publish(std::move(table));
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Retired orderbook", util::ShortString(symbol),
+        "cancelling", orderbook->numOrders(), "resting orders"
     );
-    #endif
+    orderbook->retire(); // after unrouting, so nothing can rest on it afterwards
+    return true;
+}
+
+template<typename EventSink>
+void BasicOrderBookManager<EventSink>::clearBooks() {
+    std::lock_guard<std::mutex> lock(admin_mutex_);
+    routing_table_.store(&empty_table_, std::memory_order_release);
+    tables_.clear();
+    orderbooks_.clear();
+    directory_.clear();
+}
+
+template<typename EventSink>
+bool BasicOrderBookManager<EventSink>::createOrderBook(const std::string& symbol, uint32_t ladder_ticks) {
+    return createOrderBook(convertStrToTicker(symbol), ladder_ticks);
+}
+
+template<typename EventSink>
+typename BasicOrderBookManager<EventSink>::SubscribeResult
+BasicOrderBookManager<EventSink>::subscribe(const uint64_t symbol) {
+    OrderBook* orderbook = findOrderBook(directory_.find(symbol));
+    if (orderbook == nullptr) {
+        static OrderBook dangler;
+        logging::Logger::Log(
+            logging::LogType::Debug,
+            util::getLogTimestamp(),
+            "Failed to subscribe to orderbook",
+            util::ShortString(symbol)
+        );
+        return {false, dangler};
+    }
+    logging::Logger::Log(
+        logging::LogType::Debug,
+        util::getLogTimestamp(),
+        "Successfully subscribed to orderbook", util::ShortString(symbol)
+    );
+    return {true, *orderbook};
+}
+
+template<typename EventSink>
+typename BasicOrderBookManager<EventSink>::SubscribeResult
+BasicOrderBookManager<EventSink>::subscribe(const std::string& symbol) {
+    return subscribe(convertStrToTicker(symbol));
+}
+
+template<typename EventSink>
+ticker BasicOrderBookManager<EventSink>::convertStrToTicker(const std::string& input) {
+    std::size_t len = input.length();
+    if (len > 8) len = 8;
+    char arr[8] = {0};
+    strncpy(arr, input.data(), len);
+    return *reinterpret_cast<uint64_t*>(arr);
 }
 }
 }
@@ -0,0 +1,147 @@
+#ifndef ORDER_INDEX_HPP
+#define ORDER_INDEX_HPP
+
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+namespace server {
+namespace tradeorder {
+// Order ID -> pool index map exploiting server-assigned IDs being dense and increasing.
+// IDs are split into pages of PAGE_SIZE; a sliding window of WINDOW_PAGES pages is held
+// direct-mapped in a ring (page p lives in slot p % WINDOW_PAGES), so a lookup is a tag
+// compare plus one array read. Pages are dropped once their last order dies. When a new
+// ID pushes the window forward, orders still alive in pages that fall out of it, and any
+// IDs older than the window, are kept in a hash map of stragglers instead.
+class OrderIndex {
+public:
+    using order_id = uint64_t;
+    using value = uint32_t;
+    static constexpr value NIL = static_cast<value>(-1);
+    static constexpr std::size_t PAGE_BITS = 10;
+    static constexpr std::size_t PAGE_SIZE = 1ULL << PAGE_BITS;
+    static constexpr std::size_t WINDOW_PAGES = 256; // 256k IDs, at most 1MB of pages per book
+    OrderIndex() {page_tags_.fill(NO_PAGE);}
+    value find(const order_id id) const;
+    bool insert(const order_id id, const value val); // false if already present
+    value erase(const order_id id); // NIL if not present
+    std::size_t size() const {return size_;}
+    std::size_t stragglers() const {return stragglers_.size();}
+    // warms the cache line holding id's entry, stragglers are not worth it
+    void prefetch(const order_id id) const {
+        if (const Page* page = pageFor(id))
+            __builtin_prefetch(&page->entries[id & (PAGE_SIZE - 1)]);
+    }
+private:
+    static constexpr uint64_t NO_PAGE = static_cast<uint64_t>(-1);
+    struct Page {
+        std::array<value, PAGE_SIZE> entries;
+        uint32_t live = 0;
+    };
+    static uint64_t pageNumber(const order_id id) {return id >> PAGE_BITS;}
+    static std::size_t slotOf(const uint64_t page_no) {return page_no & (WINDOW_PAGES - 1);}
+    Page* pageFor(const order_id id) const {
+        const uint64_t page_no = pageNumber(id);
+        const std::size_t slot = slotOf(page_no);
+        return page_tags_[slot] == page_no ? window_[slot].get() : nullptr;
+    }
+    Page& claimPage(const uint64_t page_no);
+    void advanceWindow(const uint64_t new_base);
+
+    std::array<uint64_t, WINDOW_PAGES> page_tags_;
+    std::array<std::unique_ptr<Page>, WINDOW_PAGES> window_;
+    uint64_t base_page_ = 0;
+    std::size_t size_ = 0;
+    std::unordered_map<order_id, value> stragglers_;
+};
+
+inline OrderIndex::value OrderIndex::find(const order_id id) const {
+    if (pageNumber(id) < base_page_) {
+        if (stragglers_.empty())
+            return NIL;
+        auto itr = stragglers_.find(id);
+        return itr == stragglers_.end() ? NIL : itr->second;
+    }
+    const Page* page = pageFor(id);
+    return page == nullptr ? NIL : page->entries[id & (PAGE_SIZE - 1)];
+}
+
+inline bool OrderIndex::insert(const order_id id, const value val) {
+    const uint64_t page_no = pageNumber(id);
+    if (page_no < base_page_) {
+        if (!stragglers_.emplace(id, val).second)
+            return false;
+        ++size_;
+        return true;
+    }
+    if (page_no >= base_page_ + WINDOW_PAGES)
+        advanceWindow(page_no - WINDOW_PAGES + 1);
+    Page* page = pageFor(id);
+    if (page == nullptr)
+        page = &claimPage(page_no);
+    value& entry = page->entries[id & (PAGE_SIZE - 1)];
+    if (entry != NIL)
+        return false;
+    entry = val;
+    ++page->live;
+    ++size_;
+    return true;
+}
+
+inline OrderIndex::value OrderIndex::erase(const order_id id) {
+    const uint64_t page_no = pageNumber(id);
+    if (page_no < base_page_) {
+        auto itr = stragglers_.find(id);
+        if (itr == stragglers_.end())
+            return NIL;
+        const value val = itr->second;
+        stragglers_.erase(itr);
+        --size_;
+        return val;
+    }
+    Page* page = pageFor(id);
+    if (page == nullptr)
+        return NIL;
+    value& entry = page->entries[id & (PAGE_SIZE - 1)];
+    const value val = entry;
+    if (val == NIL)
+        return NIL;
+    entry = NIL;
+    --size_;
+    if (--page->live == 0)
+        page_tags_[slotOf(page_no)] = NO_PAGE; // retire, the page memory is kept for reuse
+    return val;
+}
+
+inline OrderIndex::Page& OrderIndex::claimPage(const uint64_t page_no) {
+    const std::size_t slot = slotOf(page_no);
+    if (!window_[slot])
+        window_[slot] = std::make_unique<Page>();
+    Page& page = *window_[slot];
+    page.entries.fill(NIL);
+    page.live = 0;
+    page_tags_[slot] = page_no;
+    return page;
+}
+
+// pages falling out of the window spill whatever is still alive into the straggler map
+inline void OrderIndex::advanceWindow(const uint64_t new_base) {
+    for (std::size_t slot = 0; slot < WINDOW_PAGES; ++slot) {
+        const uint64_t page_no = page_tags_[slot];
+        if (page_no == NO_PAGE || page_no >= new_base)
+            continue;
+        const Page& page = *window_[slot];
+        for (std::size_t offset = 0; offset < PAGE_SIZE; ++offset) {
+            if (page.entries[offset] != NIL)
+                stragglers_.emplace((page_no << PAGE_BITS) | offset, page.entries[offset]);
+        }
+        page_tags_[slot] = NO_PAGE;
+    }
+    base_page_ = new_base;
+}
+
+}
+}
+
+#endif
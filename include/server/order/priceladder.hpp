@@ -0,0 +1,219 @@
+#ifndef PRICE_LADDER_HPP
+#define PRICE_LADDER_HPP
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "level.hpp"
+#include "occupancybitmap.hpp"
+
+namespace server {
+namespace tradeorder {
+// One side of an orderbook. Levels priced within ladder_ticks of the touch live in a
+// contiguous array indexed by (price - base), everything else falls back to an overflow map.
+// Compare orders prices best-first, matching the std::map comparator this replaces.
+// A ladder of zero ticks degenerates to the plain map book. Overflow map nodes of
+// emptied levels are kept on a spare list and re-keyed for the next new price, so
+// quote flicker away from the touch does not hit the allocator.
+template<typename Compare>
+class PriceLadder {
+public:
+    using price = uint64_t;
+    using OverflowBook = std::map<price, Level, Compare>;
+    explicit PriceLadder(uint32_t ladder_ticks = 0)
+        : slots_(ladder_ticks)
+        , occupied_(ladder_ticks)
+        , ladder_ticks_(ladder_ticks)
+    {}
+    Level* best() {return const_cast<Level*>(std::as_const(*this).best());}
+    const Level* best() const;
+    Level& getLevel(const price level_price);
+    Level* find(const price level_price) {return const_cast<Level*>(std::as_const(*this).find(level_price));}
+    const Level* find(const price level_price) const;
+    void erase(Level& level);
+    bool empty() const {return size() == 0;}
+    std::size_t size() const {return ladder_levels_ + overflow_.size();}
+    std::size_t ladderLevels() const {return ladder_levels_;}
+    uint32_t ladderTicks() const {return ladder_ticks_;}
+    price ladderBase() const {return base_;}
+    static bool isBetter(price lhs, price rhs) {return Compare()(lhs, rhs);}
+    uint64_t levelsReused() const {return levels_reused_;}
+    uint64_t levelsAllocated() const {return levels_allocated_;}
+    // warms the ladder slot for the price, overflow levels are left alone
+    void prefetch(const price p) const {
+        if (inBand(p))
+            __builtin_prefetch(&slots_[p - base_]);
+    }
+private:
+    static constexpr std::size_t MAX_SPARE_LEVELS = 256;
+    static constexpr int64_t NO_SLOT = -1;
+    static constexpr bool ascending_ = Compare()(0, 1); // asks walk up the ladder, bids walk down
+    bool inBand(const price p) const {return ladder_ticks_ && p >= base_ && p - base_ < ladder_ticks_;}
+    bool shouldRecenter(const price p) const;
+    Level& activateSlot(const std::size_t slot);
+    Level& getOverflowLevel(const price p);
+    Level& insertOverflowLevel(const Level& level);
+    void retireOverflowLevel(typename OverflowBook::iterator lvlitr);
+    int64_t nextOccupiedSlot(int64_t slot) const;
+    void recenter(const price centre);
+    void placeMigratedLevel(const Level& level);
+
+    std::vector<Level> slots_;
+    OccupancyBitmap occupied_;
+    OverflowBook overflow_;
+    std::vector<typename OverflowBook::node_type> spare_levels_;
+    price base_ = 0;
+    int64_t best_slot_ = NO_SLOT;
+    std::size_t ladder_levels_ = 0;
+    uint32_t ladder_ticks_;
+    uint64_t levels_reused_ = 0;
+    uint64_t levels_allocated_ = 0;
+};
+
+template<typename Compare>
+inline const Level* PriceLadder<Compare>::best() const {
+    const Level* ladder_best = best_slot_ == NO_SLOT ? nullptr : &slots_[best_slot_];
+    if (overflow_.empty())
+        return ladder_best;
+    const Level* overflow_best = &overflow_.begin()->second;
+    if (ladder_best == nullptr || isBetter(overflow_best->price, ladder_best->price))
+        return overflow_best;
+    return ladder_best;
+}
+
+template<typename Compare>
+inline Level& PriceLadder<Compare>::getLevel(const price level_price) {
+    if (!inBand(level_price) && shouldRecenter(level_price))
+        recenter(level_price);
+    if (inBand(level_price)) {
+        const std::size_t slot = level_price - base_;
+        levels_reused_ += !occupied_.test(slot); // ladder slots are preallocated
+        return activateSlot(slot);
+    }
+    return getOverflowLevel(level_price);
+}
+
+template<typename Compare>
+inline const Level* PriceLadder<Compare>::find(const price level_price) const {
+    if (inBand(level_price)) {
+        const std::size_t slot = level_price - base_;
+        return occupied_.test(slot) ? &slots_[slot] : nullptr;
+    }
+    auto lvlitr = overflow_.find(level_price);
+    return lvlitr == overflow_.end() ? nullptr : &lvlitr->second;
+}
+
+template<typename Compare>
+inline void PriceLadder<Compare>::erase(Level& level) {
+    if (!inBand(level.price)) {
+        retireOverflowLevel(overflow_.find(level.price));
+        return;
+    }
+    const int64_t slot = level.price - base_;
+    occupied_.clear(slot);
+    --ladder_levels_;
+    if (slot == best_slot_)
+        best_slot_ = nextOccupiedSlot(slot);
+}
+
+// the band follows the touch: move it when the ladder has drained or when
+// a new best price arrives outside of it
+template<typename Compare>
+inline bool PriceLadder<Compare>::shouldRecenter(const price p) const {
+    if (ladder_ticks_ == 0)
+        return false;
+    if (ladder_levels_ == 0)
+        return true;
+    return isBetter(p, slots_[best_slot_].price);
+}
+
+template<typename Compare>
+inline Level& PriceLadder<Compare>::activateSlot(const std::size_t slot) {
+    if (!occupied_.test(slot)) {
+        slots_[slot] = Level(base_ + slot);
+        occupied_.set(slot);
+        ++ladder_levels_;
+        if (best_slot_ == NO_SLOT || isBetter(base_ + slot, base_ + best_slot_))
+            best_slot_ = slot;
+    }
+    return slots_[slot];
+}
+
+template<typename Compare>
+inline Level& PriceLadder<Compare>::getOverflowLevel(const price p) {
+    auto lvlitr = overflow_.find(p);
+    if (lvlitr == overflow_.end())
+        return insertOverflowLevel(Level(p));
+    return lvlitr->second;
+}
+
+template<typename Compare>
+inline Level& PriceLadder<Compare>::insertOverflowLevel(const Level& level) {
+    if (spare_levels_.empty()) {
+        ++levels_allocated_;
+        return overflow_.emplace(level.price, level).first->second;
+    }
+    auto node = std::move(spare_levels_.back());
+    spare_levels_.pop_back();
+    node.key() = level.price;
+    node.mapped() = level;
+    ++levels_reused_;
+    return overflow_.insert(std::move(node)).position->second;
+}
+
+template<typename Compare>
+inline void PriceLadder<Compare>::retireOverflowLevel(typename OverflowBook::iterator lvlitr) {
+    if (spare_levels_.size() < MAX_SPARE_LEVELS)
+        spare_levels_.push_back(overflow_.extract(lvlitr));
+    else
+        overflow_.erase(lvlitr);
+}
+
+template<typename Compare>
+inline int64_t PriceLadder<Compare>::nextOccupiedSlot(int64_t slot) const {
+    std::size_t next;
+    if (ascending_)
+        next = slot + 1 < ladder_ticks_ ? occupied_.nextSet(slot + 1) : OccupancyBitmap::NPOS;
+    else
+        next = slot > 0 ? occupied_.prevSet(slot - 1) : OccupancyBitmap::NPOS;
+    return next == OccupancyBitmap::NPOS ? NO_SLOT : static_cast<int64_t>(next);
+}
+
+// rare: shift the band so that centre sits in the middle of it, spilling levels
+// that fall out into the overflow map and pulling overflow levels that fall in
+template<typename Compare>
+void PriceLadder<Compare>::recenter(const price centre) {
+    std::vector<Level> migrating;
+    migrating.reserve(ladder_levels_);
+    for (std::size_t slot = occupied_.nextSet(0); slot != OccupancyBitmap::NPOS; slot = occupied_.nextSet(slot)) {
+        migrating.push_back(slots_[slot]);
+        occupied_.clear(slot);
+    }
+    ladder_levels_ = 0;
+    best_slot_ = NO_SLOT;
+    base_ = centre > ladder_ticks_ / 2 ? centre - ladder_ticks_ / 2 : 0;
+    for (const auto& level : migrating)
+        placeMigratedLevel(level);
+    auto overflow_itr = overflow_.lower_bound(ascending_ ? base_ : base_ + ladder_ticks_ - 1);
+    while (overflow_itr != overflow_.end() && inBand(overflow_itr->first)) {
+        placeMigratedLevel(overflow_itr->second);
+        retireOverflowLevel(overflow_itr++);
+    }
+}
+
+// limits refer to their level by price, so levels move without touching their queues
+template<typename Compare>
+inline void PriceLadder<Compare>::placeMigratedLevel(const Level& level) {
+    if (inBand(level.price))
+        activateSlot(level.price - base_) = level;
+    else
+        insertOverflowLevel(level);
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SYMBOL_DIRECTORY_HPP
+#define SYMBOL_DIRECTORY_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace server {
+namespace tradeorder {
+using instrument_id = uint32_t;
+constexpr instrument_id NO_INSTRUMENT = -1;
+
+// Session wide map from 8 byte symbols to dense instrument ids, handed out from zero
+// in creation order. A symbol keeps its id if its book is retired and recreated.
+// Orders, books and the market data feed only carry the id, symbols are looked up
+// here when books are created and when the directory is broadcast.
+class SymbolDirectory {
+public:
+    using Entry = std::pair<instrument_id, uint64_t>;
+    // the existing id if the symbol is already known
+    instrument_id add(uint64_t symbol) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto itr = ids_.find(symbol);
+        if (itr != ids_.end())
+            return itr->second;
+        const instrument_id id = static_cast<instrument_id>(symbols_.size());
+        ids_.emplace(symbol, id);
+        symbols_.push_back(symbol);
+        return id;
+    }
+    instrument_id find(uint64_t symbol) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto itr = ids_.find(symbol);
+        return itr == ids_.end() ? NO_INSTRUMENT : itr->second;
+    }
+    // 0 if the id was never handed out
+    uint64_t symbol(instrument_id id) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return id < symbols_.size() ? symbols_[id] : 0;
+    }
+    std::vector<Entry> entries() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Entry> entries;
+        entries.reserve(symbols_.size());
+        for (instrument_id id = 0; id < symbols_.size(); ++id)
+            entries.emplace_back(id, symbols_[id]);
+        return entries;
+    }
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return symbols_.size();
+    }
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ids_.clear();
+        symbols_.clear();
+    }
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, instrument_id> ids_;
+    std::vector<uint64_t> symbols_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ADMIN_CALL_HPP
+#define ADMIN_CALL_HPP
+
+#include <functional>
+#include <grpcpp/grpcpp.h>
+
+#include "orderentry.grpc.pb.h"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace rpc {
+using AdminServiceType = orderentry::AdminService::AsyncService;
+using InstrumentRequestType = orderentry::InstrumentRequest;
+using InstrumentResponseType = orderentry::InstrumentResponse;
+
+struct AdminHandlers {
+    std::function<bool(uint64_t, uint32_t)> create_orderbook_fn;
+    std::function<bool(uint64_t)> retire_orderbook_fn;
+};
+
+// One unary Instrument call, adds or retires an orderbook while the server runs.
+// Each call queues the next before handling its own request, and deletes itself
+// once the response is sent.
+class AdminCall final {
+public:
+    AdminCall(AdminServiceType* service, grpc::ServerCompletionQueue* cq,
+        const AdminHandlers& handlers);
+private:
+    void processRequest(bool success);
+    void onFinish(bool);
+
+    AdminServiceType* service_;
+    grpc::ServerCompletionQueue* cq_;
+    const AdminHandlers& handlers_;
+    grpc::ServerContext server_context_;
+    InstrumentRequestType request_;
+    InstrumentResponseType response_;
+    grpc::ServerAsyncResponseWriter<InstrumentResponseType> responder_;
+    std::function<void(bool)> process_request_cb_;
+    std::function<void(bool)> on_finish_cb_;
+};
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef ARENA_QUEUE_HPP
+#define ARENA_QUEUE_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <google/protobuf/arena.h>
+
+#include "boundedqueue.hpp"
+
+namespace rpc {
+// Fixed capacity FIFO of protobuf messages allocated on two rotating arenas, not
+// thread safe. push() creates an empty message on the current arena, so building or
+// copying into it only bumps a pointer inside a block the queue already owns.
+// An arena is reset in bulk as soon as every message on it has been popped. Queues
+// that keep up drain often and reset every time they do; a queue that never drains
+// moves new messages to the other arena after a capacity's worth, and the old one
+// resets once its messages have all been written.
+template<typename Message>
+class ArenaQueue {
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+    explicit ArenaQueue(std::size_t capacity, std::size_t block_size = DEFAULT_BLOCK_SIZE)
+        : entries_(capacity)
+    {
+        for (std::size_t i = 0; i < arenas_.size(); ++i) {
+            blocks_[i].reset(new char[block_size]);
+            arenas_[i].reset(new google::protobuf::Arena(blocks_[i].get(), block_size));
+        }
+    }
+    ArenaQueue(const ArenaQueue&) = delete;
+    ArenaQueue& operator=(const ArenaQueue&) = delete;
+    // must not be full
+    Message& push() {
+        const uint8_t other = current_ ^ 1;
+        if (created_[current_] >= entries_.capacity() && live_[other] == 0)
+            current_ = other;
+        Message* message = google::protobuf::Arena::CreateMessage<Message>(arenas_[current_].get());
+        entries_.push() = {message, current_};
+        ++live_[current_];
+        ++created_[current_];
+        return *message;
+    }
+    // must not be empty, the message must not be in use any more
+    void pop() {
+        const uint8_t arena = entries_.front().arena;
+        entries_.pop();
+        if (--live_[arena] == 0) {
+            arenas_[arena]->Reset();
+            created_[arena] = 0;
+        }
+    }
+    Message& front() {return *entries_.front().message;}
+    Message& back() {return *entries_.back().message;}
+    Message& operator[](std::size_t i) {return *entries_[i].message;}
+    std::size_t size() const {return entries_.size();}
+    std::size_t capacity() const {return entries_.capacity();}
+    bool empty() const {return entries_.empty();}
+    bool full() const {return entries_.full();}
+    // bytes handed out since each arena's last reset, for metrics
+    uint64_t spaceUsed() const {return arenas_[0]->SpaceUsed() + arenas_[1]->SpaceUsed();}
+private:
+    struct Entry {
+        Message* message = nullptr;
+        uint8_t arena = 0;
+    };
+    util::BoundedQueue<Entry> entries_;
+    std::array<std::unique_ptr<char[]>, 2> blocks_; // first block of each arena, kept across resets
+    std::array<std::unique_ptr<google::protobuf::Arena>, 2> arenas_;
+    std::array<std::size_t, 2> live_{};    // queued messages on each arena
+    std::array<std::size_t, 2> created_{}; // messages created since each arena's last reset
+    uint8_t current_ = 0;
+};
+}
+
+#endif
@@ -1,45 +1,117 @@
 #ifndef MARKETDATA_DISPATCHER_HPP
 #define MARKETDATA_DISPATCHER_HPP
 
+#include <array>
+#include <atomic>
 #include <memory>
 #include <thread>
-#include <list>
 #include <chrono>
 #include <mutex>
 
 #include "orderentrystreamconnection.hpp"
+#include "mpscring.hpp"
+#include "histogram.hpp"
+#include "marketdatarecord.hpp"
+#include "shmring.hpp"
 #include "logger.hpp"
 #include "util.hpp"
 #include "orderentry.grpc.pb.h"
 
-using MDResponseType = orderentry::MarketDataResponse;
+using MDBatchType = orderentry::MarketDataBatch;
 using MDRequestType = orderentry::InitiateMarketDataStreamRequest;
 namespace rpc {
 using WriteCallback = std::function<void(bool)>;
 using Time = std::chrono::_V2::system_clock::time_point;
+
+// Fixed size market data event, only turned into a protobuf message on the
+// dispatcher thread.
+struct MarketDataEvent {
+    enum class Type : uint8_t {add, modify, replace, cancel, fill, instrument};
+    Type type;
+    uint8_t flag; // is_buy_side for add, complete_fill for fill
+    uint32_t quantity;
+    uint32_t instrument_id;
+    uint64_t timestamp;
+    uint64_t order_id;
+    uint64_t price; // symbol for instrument
+    uint64_t user_id;
+};
+
+// Every publishing thread gets its own ring on first use, so matching threads hand
+// events over without locks or allocation. One dispatcher thread drains the rings and
+// encodes the events straight into subscriber records, appended to a batch while the
+// previous batch is being written, so every write carries everything that arrived
+// during the last one and the data platform only forwards bytes.
+// Each thread's events keep their order, events from different threads interleave.
+// A thread about to hand a book to another calls flushThisThread() first, so the book's
+// events from both threads come out in order.
+// With a shared memory bus the records go to a ring the data platform polls on the
+// same host instead, as soon as they are drained.
 class MarketDataDispatcher {
 public:
+    static constexpr std::size_t RING_CAPACITY = 1 << 14;
+    static constexpr std::size_t MAX_PUBLISHERS = 256;
+    static constexpr std::size_t MAX_BATCH = 8192; // events per write
+    static constexpr std::size_t BATCH_RESERVE = MAX_BATCH * 16; // typical record size
+    static constexpr std::size_t BUS_CAPACITY = 1 << 16; // records
+    using BatchHistogram = util::Log2Histogram<14>; // 1 to 8192
     MarketDataDispatcher(
         grpc::ServerCompletionQueue* cq,
         orderentry::MarketDataService::AsyncService* market_data_service
     );
-    MarketDataDispatcher(const MarketDataDispatcher&) = default;
-    MarketDataDispatcher& operator=(MarketDataDispatcher& rhs) = default;
+    MarketDataDispatcher(const MarketDataDispatcher&) = delete;
+    MarketDataDispatcher& operator=(const MarketDataDispatcher&) = delete;
+    ~MarketDataDispatcher() {stop();}
+    // publish to a shared memory ring under /dev/shm instead of the grpc stream,
+    // must be called before initiateMarketDataDispatch
+    void useSharedMemoryBus(const std::string& name);
+    // waits for the data platform unless on the bus, then starts the dispatcher thread
     bool initiateMarketDataDispatch();
-    void writeMarketData(const MDResponseType* marketdata);
+    // spins while this thread's ring is full
+    void publish(const MarketDataEvent& event);
+    // returns once the dispatcher has taken everything this thread published
+    void flushThisThread();
+    // drains every ring and pending write before joining
+    void stop();
     void setCQ(grpc::ServerCompletionQueue* cq) {cq_ = cq;}
 private:
+    // the records string keeps its capacity when cleared, so batches stop allocating
+    // once they have grown to the busiest write
+    struct Batch {
+        MDBatchType message;
+        std::size_t events = 0;
+    };
+    struct Publisher {
+        util::MPSCRing<MarketDataEvent> ring{RING_CAPACITY};
+        std::atomic<std::size_t> taken{0}; // ring position the dispatcher has popped up to
+    };
+    Publisher& publisher();
+    void run();
+    bool drain(Publisher& publisher, Batch& batch);
+    void encode(const MarketDataEvent& event, std::string& records);
+    void publishToBus(Batch& batch);
     void writeToMDPlatform(bool success);
     orderentry::MarketDataService::AsyncService* market_data_service_;
-    grpc::ServerAsyncWriter<MDResponseType> market_data_writer_;
+    grpc::ServerAsyncWriter<MDBatchType> market_data_writer_;
     grpc::ServerCompletionQueue* cq_;
     grpc::ServerContext server_context_;
-    std::list<MDResponseType> market_data_queue_;
     WriteCallback write_marketdata_;
-    MDResponseType md_response_;
     MDRequestType md_request_;
-    std::mutex mdmutex_;
+    std::array<std::unique_ptr<Publisher>, MAX_PUBLISHERS> publishers_;
+    std::atomic<std::size_t> num_publishers_{0};
+    std::mutex publishers_mutex_; // registration only
+    // dispatcher thread only, the other batch is being written while write_in_progress_
+    std::array<Batch, 2> batches_;
+    uint8_t filling_ = 0;
     bool write_in_progress_ = false;
+    BatchHistogram batch_sizes_;
+    std::unique_ptr<util::ShmRing> bus_;
+    bool stream_ok_ = false;
+    // set by the completion queue thread
+    std::atomic<bool> write_done_{false};
+    std::atomic<bool> write_ok_{false};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
 };
 }
 
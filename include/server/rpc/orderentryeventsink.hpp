@@ -0,0 +1,43 @@
+#ifndef ORDER_ENTRY_EVENT_SINK_HPP
+#define ORDER_ENTRY_EVENT_SINK_HPP
+
+#include "orderentry.grpc.pb.h"
+#include "orderentrystreamconnection.hpp"
+#include "marketdatadispatcher.hpp"
+#include "eventsink.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace rpc {
+using RejectReason = server::tradeorder::RejectReason;
+// production sink: acks and fills go back over the client's order entry stream,
+// book changes go to the market data dispatcher as fixed size events.
+// With a session registry, fills and rejections are routed by user id so nothing is
+// written to a session that has since disconnected. Without one they go to the
+// connection they carry, the matching engine carries none and needs the registry.
+class OrderEntryEventSink {
+public:
+    explicit OrderEntryEventSink(MarketDataDispatcher* md_dispatch = nullptr,
+        const SessionRegistry* sessions = nullptr)
+        : md_dispatch_(md_dispatch)
+        , sessions_(sessions)
+    {}
+    void onAdd(const ::tradeorder::Order& order);
+    void onFill(const info::Fill& fill, const ::tradeorder::Order& order);
+    void onModify(const info::ModifyOrder& modify_order);
+    void onReplace(const info::ModifyOrder& modify_order);
+    void onCancel(const info::CancelOrder& cancel_order);
+    void onReject(RejectReason reason, OrderEntryStreamConnection* connection,
+        uint64_t user_id, uint64_t order_id, uint64_t ticker);
+    // market data already leaves through this thread's ring, nothing to hold back
+    void onBatchBegin() {}
+    void onBatchEnd() {}
+    void onHandOff() {md_dispatch_->flushThisThread();}
+private:
+    MarketDataDispatcher* md_dispatch_;
+    const SessionRegistry* sessions_;
+    static thread_local orderentry::OrderEntryResponse orderfill_ack;
+};
+}
+
+#endif
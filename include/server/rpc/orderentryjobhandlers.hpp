@@ -13,11 +13,15 @@ namespace info {
     struct CancelOrder;
 }
 
+namespace grpc {
+    class ServerCompletionQueue;
+}
+
 struct OEJobHandlers {
     std::function<void(::tradeorder::Order&)> add_order_fn;
     std::function<void(info::ModifyOrder&)> modify_order_fn;
     std::function<void(info::CancelOrder&)> cancel_order_fn;
-    std::function<void()> create_new_conn_fn;
+    std::function<void(grpc::ServerCompletionQueue*)> create_new_conn_fn; // on the accepting queue
     std::function<void()> set_context_fn;
 };
 
@@ -8,11 +8,16 @@
 #include <list>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 
 #include "logger.hpp"
 #include "orderentry.grpc.pb.h"
 #include "util.hpp"
+#include "idallocator.hpp"
+#include "sessiontable.hpp"
+#include "arenaqueue.hpp"
+#include "histogram.hpp"
 #include "order.hpp"
 #include "ordertypes.hpp"
 #include "orderentryjobhandlers.hpp"
@@ -23,28 +28,63 @@ using ServiceType = orderentry::OrderEntryService::AsyncService;
 using TagProcessor = std::function<void(bool)>;
 using Rejection = orderentry::OrderEntryRejection::RejectionReason;
 using Common = orderentry::OrderCommon;
+class OrderEntryStreamConnection;
+using SessionRegistry = util::SessionTable<OrderEntryStreamConnection>;
+
+// What to do with a response for a session whose outbound queue is full.
+// coalesce: fold a fill into an unsent fill for the same order queued behind the last
+//     non fill response, anything that cannot be folded disconnects.
+// disconnect: drop the session straight away.
+// block: wait up to block_timeout for the client to catch up, then disconnect. Only the
+//     matching threads wait, on a session pinned through the registry rather than
+//     under its lock. A session's own rpc thread is the one that drains its queue so
+//     its acks disconnect instead. Without matching threads fills are written
+//     from rpc threads too, prefer coalesce there.
+enum class SlowConsumerPolicy : uint8_t {coalesce, disconnect, block};
+struct OutboundLimits {
+    std::size_t capacity = 1024; // responses queued per session
+    SlowConsumerPolicy policy = SlowConsumerPolicy::coalesce;
+    std::chrono::milliseconds block_timeout{50};
+};
+// totals over every session
+struct OutboundStats {
+    std::atomic<uint64_t> max_depth{0};
+    std::atomic<uint64_t> coalesced{0};
+    std::atomic<uint64_t> blocked{0};
+    std::atomic<uint64_t> disconnected{0};
+};
 
 class OrderEntryStreamConnection final {
 public:
+    using DepthHistogram = util::Log2Histogram<12>; // 1 to 2048 queued
     OrderEntryStreamConnection(
         ServiceType* service, 
         grpc::ServerCompletionQueue* completion_q, 
-        std::unordered_map<uint64_t, OrderEntryStreamConnection*>& client_streams,
+        SessionRegistry& client_streams,
         OEJobHandlers& jobhandlers
     );
     const uint64_t getUserID() const {return userid_;}
+    // held by other threads writing to the session, see SessionTable::visitPinned
+    void pin() {pins_.fetch_add(1, std::memory_order_relaxed);}
+    void unpin() {pins_.fetch_sub(1, std::memory_order_release);}
     void writeToClient(const OEResponseType* response);
     void sendRejection(const Rejection rejection, const uint64_t userid,
-        const uint64_t orderid, const uint64_t ticker);
+        const uint64_t orderid, const uint64_t instrument);
     void onStreamCancelled(bool); // notification tag callback for stream termination
-    alignas(64) static std::atomic<uint64_t> orderid_generator_; // dont want to false share the orderid generator with current_async_ops
-    static std::chrono::_V2::system_clock::time_point t0;
+    static util::IDAllocator orderid_allocator_;
+    static OutboundLimits outbound_limits_; // set before the first session connects
+    static OutboundStats outbound_stats_;
 private:
     void sendResponseFromQueue(bool success);
+    void queueResponse(const OEResponseType& response, bool may_block);
+    bool makeRoom(const OEResponseType& response, std::unique_lock<std::mutex>& lock, bool may_block);
+    bool coalesceFill(const OEResponseType& response);
+    void disconnectSlowConsumer();
     void initialiseOEConn(bool success);
     void verifyID(bool success);
     void readOrderEntryCallback(bool success);
     void processEntry();
+    void recycleRequest();
     bool userIDUsageRejection(const Common& common);
     template<typename OrderType>
     void handleOrderType(const OrderType& order);
@@ -63,7 +103,14 @@ private:
     grpc::ServerCompletionQueue* completion_queue_;
     grpc::ServerContext server_context_;
     grpc::Alarm alarm_;
-    OERequestType oe_request_;
+    // each request is read into a message on the session's arena, which is reset in
+    // bulk between reads every REQUESTS_PER_ARENA_RESET requests
+    static constexpr std::size_t REQUEST_BLOCK_SIZE = 4096;
+    static constexpr uint32_t REQUESTS_PER_ARENA_RESET = 256;
+    std::unique_ptr<char[]> request_block_;
+    google::protobuf::Arena request_arena_;
+    OERequestType* oe_request_;
+    uint32_t requests_since_reset_ = 0;
     grpc::ServerAsyncReaderWriter<OEResponseType, OERequestType> grpc_responder_;
     TagProcessor initialise_oe_conn_callback_;
     TagProcessor read_orderentry_callback_;
@@ -75,17 +122,22 @@ private:
     std::function<void(tradeorder::Order&)> add_order_fn_;
     std::function<void(info::ModifyOrder&)> modify_order_fn_;
     std::function<void(info::CancelOrder&)> cancel_order_fn_;
-    std::function<void()> create_new_conn_fn_;
-    std::list<OEResponseType> response_queue_;
+    std::function<void(grpc::ServerCompletionQueue*)> create_new_conn_fn_;
+    rpc::ArenaQueue<OEResponseType> response_queue_; // front is being written while write_in_progress_
     std::list<OERequestType> request_queue_;
     std::mutex response_queue_mutex_;
-    std::unordered_map<uint64_t, OrderEntryStreamConnection*>& client_streams_;
+    std::condition_variable response_queue_space_;
+    DepthHistogram response_queue_depth_; // sampled on every queued response
+    bool disconnecting_ = false;
+    SessionRegistry& client_streams_;
     uint64_t userid_;
     std::string user_address_;
     std::atomic<uint64_t> current_async_ops_;
+    std::atomic<uint32_t> pins_{0};
     bool server_stream_done_;
     bool on_streamcancelled_called_;
     bool write_in_progress_ = false;
+    util::IDAllocator::Block order_ids_; // reads are one at a time, so this needs no lock
 
     static thread_local OEResponseType neworder_ack; 
     static thread_local OEResponseType modorder_ack; 
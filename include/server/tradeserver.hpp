@@ -1,6 +1,7 @@
 #ifndef TRADE_SERVER_HPP
 #define TRADE_SERVER_HPP
 
+#include <algorithm>
 #include <memory>
 #include <fstream>
 #include <functional>
@@ -8,6 +9,7 @@
 #include <iostream>
 #include <unordered_map>
 #include <list>
+#include <vector>
 #include <mutex>
 #include <grpcpp/grpcpp.h>
 #include <grpcpp/alarm.h>
@@ -21,6 +23,9 @@
 #include "marketdatadispatcher.hpp"
 #include "orderentrystreamconnection.hpp"
 #include "orderbookmanager.hpp"
+#include "matchingengine.hpp"
+#include "orderentryeventsink.hpp"
+#include "admincall.hpp"
 #include "order.hpp"
 #include "level.hpp"
 #include "fifomatching.hpp"
@@ -34,26 +39,61 @@ using OrderRejection = orderentry::OrderEntryRejection::RejectionReason;
 using user_id = uint64_t;
 
 namespace server {
+using OrderBookManager = tradeorder::BasicOrderBookManager<rpc::OrderEntryEventSink>;
+using MatchingEngine = tradeorder::BasicMatchingEngine<rpc::OrderEntryEventSink>;
+using SymbolDirectory = tradeorder::SymbolDirectory;
 class TradeServer final {
 public:
-    TradeServer(char* port, const std::string& filename);
+    // matching_threads > 0 gives every orderbook to one of that many matching threads.
+    // Each rpc thread polls its own completion queue, 0 means one per hardware thread.
+    // outbound_limits bound every order entry session's queue of unsent responses.
+    // A market_data_bus name sends market data over shared memory instead of grpc.
+    // Matching threads are pinned to the first cpus unless pin_matching_threads is off.
+    // The admin service has its own listener, on loopback at port + 1 unless an
+    // admin_address is given, so it is never reachable through the order entry port.
+    // Books get a price ladder of ladder_ticks per side, also for admin requests that
+    // leave it at 0. A ladder_ticks of 0 keeps every book on the plain map.
+    TradeServer(char* port, const std::string& filename, uint32_t matching_threads = 0,
+        uint32_t rpc_threads = 0, bool pin_rpc_threads = false,
+        const OutboundLimits& outbound_limits = OutboundLimits(),
+        const std::string& market_data_bus = "", bool pin_matching_threads = true,
+        const std::string& admin_address = "", uint32_t ladder_ticks = DEFAULT_LADDER_TICKS);
     static void shutdownServer();
+    // ticks either side of the touch a book indexes directly, see priceladder.hpp
+    static constexpr uint32_t DEFAULT_LADDER_TICKS = 1024;
 private:
-    void handleRemoteProcedureCalls();
+    // how often the matching engine may move a book off its busiest thread
+    static constexpr std::chrono::milliseconds REBALANCE_INTERVAL{1000};
+    void handleRemoteProcedureCalls(uint32_t first_cpu, bool pin_rpc_threads);
+    void startAdminServer(const std::string& admin_address);
+    void serveAdminCalls();
     void createOrderEntryRPC();
     void setupMarketDataStream();
-    static void makeNewOrderEntryConnection();
+    bool createOrderBook(uint64_t symbol, uint32_t ladder_ticks);
+    static bool retireOrderBook(uint64_t symbol);
+    const SymbolDirectory& symbolDirectory() const;
+    void publishInstrument(uint32_t instrument_id, uint64_t symbol);
+    void publishSymbolDirectory();
+    void startMatchingEngine(uint32_t matching_threads);
+    static void makeNewOrderEntryConnection(grpc::ServerCompletionQueue* cq);
     struct ::sigaction disposition_;
     std::mutex taglist_mutex_;
     std::vector<std::thread> threadpool_;
-    rpc::MarketDataDispatcher marketdata_dispatcher_;
-    tradeorder::OrderBookManager ordermanager_;
+    OrderBookManager ordermanager_;
+    const uint32_t ladder_ticks_;
+    bool marketdata_live_ = false;
     static std::unique_ptr<grpc::Server> trade_server_;
-    static std::unique_ptr<grpc::ServerCompletionQueue> cq_;
+    static std::unique_ptr<grpc::Server> admin_server_;
+    static std::unique_ptr<grpc::ServerCompletionQueue> admin_cq_;
+    static rpc::MarketDataDispatcher marketdata_dispatcher_;
+    static std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> cqs_;
     static orderentry::OrderEntryService::AsyncService order_entry_service_;
     static orderentry::MarketDataService::AsyncService market_data_service_;
-    static std::unordered_map<user_id, OrderEntryStreamConnection*> client_streams_;
+    static rpc::AdminServiceType admin_service_;
+    static rpc::AdminHandlers admin_handlers_;
+    static SessionRegistry client_streams_;
     static OEJobHandlers job_handlers_;
+    static std::unique_ptr<MatchingEngine> matching_engine_;
 };
 }
 
@@ -0,0 +1,52 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "exception.hpp"
+
+namespace util {
+// Fixed capacity FIFO over slots allocated once up front, not thread safe.
+// Slots are reused in place: push() hands back the next free slot still holding
+// whatever it held last, so assigning over it lets types like protobuf messages
+// keep their own buffers instead of allocating on every push.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(std::size_t capacity)
+        : slots_(capacity)
+    {
+        if (capacity == 0)
+            throw EngineException("BoundedQueue capacity must be non zero");
+    }
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+    // must not be full
+    T& push() {
+        T& slot = slots_[wrap(head_ + size_)];
+        ++size_;
+        return slot;
+    }
+    // must not be empty
+    void pop() {
+        head_ = wrap(head_ + 1);
+        --size_;
+    }
+    T& front() {return slots_[head_];}
+    T& back() {return slots_[wrap(head_ + size_ - 1)];}
+    // i-th queued element counting from the front
+    T& operator[](std::size_t i) {return slots_[wrap(head_ + i)];}
+    std::size_t size() const {return size_;}
+    std::size_t capacity() const {return slots_.size();}
+    bool empty() const {return size_ == 0;}
+    bool full() const {return size_ == slots_.size();}
+private:
+    std::size_t wrap(std::size_t i) const {return i < slots_.size() ? i : i - slots_.size();}
+    std::vector<T> slots_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+};
+}
+
+#endif
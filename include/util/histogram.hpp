@@ -0,0 +1,50 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace util {
+// Counts samples in power of two buckets: bucket 0 holds 0 and 1, bucket b holds
+// [2^b, 2^(b+1)) and the last bucket everything above. One thread records, any
+// thread may read, so counts are relaxed atomics without a read-modify-write.
+template<std::size_t Buckets>
+class Log2Histogram {
+public:
+    static_assert(Buckets > 0 && Buckets <= 64, "one bucket per bit at most");
+    void record(uint64_t sample) {
+        auto& count = counts_[bucketOf(sample)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    uint64_t count(std::size_t bucket) const {return counts_[bucket].load(std::memory_order_relaxed);}
+    uint64_t total() const {
+        uint64_t total = 0;
+        for (const auto& count : counts_)
+            total += count.load(std::memory_order_relaxed);
+        return total;
+    }
+    static std::size_t bucketOf(uint64_t sample) {
+        if (sample <= 1)
+            return 0;
+        return std::min<std::size_t>(Buckets - 1, 63 - __builtin_clzll(sample));
+    }
+    static uint64_t bucketFloor(std::size_t bucket) {return bucket == 0 ? 0 : 1ULL << bucket;}
+    // "1:40 2:12 4:3 ..." keyed by each bucket's lowest sample
+    std::string toString() const {
+        std::string out;
+        for (std::size_t i = 0; i < Buckets; ++i) {
+            if (i > 0)
+                out += ' ';
+            out += std::to_string(i == 0 ? 1 : bucketFloor(i)) + ':' + std::to_string(count(i));
+        }
+        return out;
+    }
+private:
+    std::array<std::atomic<uint64_t>, Buckets> counts_{};
+};
+}
+
+#endif
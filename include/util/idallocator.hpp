@@ -0,0 +1,54 @@
+#ifndef ID_ALLOCATOR_HPP
+#define ID_ALLOCATOR_HPP
+
+#include <atomic>
+#include <cstdint>
+
+#include "exception.hpp"
+
+namespace util {
+// Globally unique ids handed out in blocks. Each thread or session keeps its own
+// Block and only touches the shared counter once per block, instead of bouncing
+// one cache line between every core on every id. Ids from one block are
+// consecutive and blocks are claimed in increasing order, but a session that
+// goes idle keeps its block, so there is no bound on how far behind the newest
+// its ids get. Old ids that have fallen out of the OrderIndex window go to its
+// straggler hash, which is correct but slower.
+class IDAllocator {
+public:
+    static constexpr uint64_t DEFAULT_BLOCK_SIZE = 256;
+    // not thread safe, one per thread or session
+    class Block {
+    public:
+        uint64_t next(IDAllocator& allocator) {
+            if (next_ == end_)
+                allocator.reserve(*this);
+            return next_++;
+        }
+        uint64_t remaining() const {return end_ - next_;}
+    private:
+        friend class IDAllocator;
+        uint64_t next_ = 0;
+        uint64_t end_ = 0;
+    };
+    explicit IDAllocator(uint64_t first_id = 1, uint64_t block_size = DEFAULT_BLOCK_SIZE)
+        : block_size_(block_size)
+        , next_block_(first_id)
+    {
+        if (block_size == 0)
+            throw EngineException("IDAllocator block size must be non zero");
+    }
+    IDAllocator(const IDAllocator&) = delete;
+    IDAllocator& operator=(const IDAllocator&) = delete;
+    void reserve(Block& block) {
+        block.next_ = next_block_.fetch_add(block_size_, std::memory_order_relaxed);
+        block.end_ = block.next_ + block_size_;
+    }
+    uint64_t blockSize() const {return block_size_;}
+private:
+    const uint64_t block_size_;
+    alignas(64) std::atomic<uint64_t> next_block_; // only the counter shares this line
+};
+}
+
+#endif
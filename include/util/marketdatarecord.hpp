@@ -0,0 +1,71 @@
+#ifndef MARKET_DATA_RECORD_HPP
+#define MARKET_DATA_RECORD_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Market data records exactly as subscribers receive them: payload length, type
+// character, then the fields in host byte order without padding. The server encodes
+// each event once, the data platform forwards the bytes untouched.
+// Datagrams to subscribers are framed MoldUDP64 style: session, sequence number of
+// the first record and record count, then as many records as fit back to back, each
+// led by its own length byte. Instruments replayed to a new subscriber go out with
+// sequence number 0.
+
+namespace util {
+constexpr std::size_t md_header_len_ = 2;
+constexpr uint8_t add_data_len_ = 33;
+constexpr uint8_t mod_data_len_ = 20;
+constexpr uint8_t replace_data_len_ = 28;
+constexpr uint8_t cancel_data_len_ = 16;
+constexpr uint8_t fill_data_len_ = 32;
+constexpr uint8_t instrument_data_len_ = 12;
+constexpr std::size_t md_session_len_ = 10;
+constexpr std::size_t md_datagram_header_len_ = md_session_len_ + sizeof(uint64_t) + sizeof(uint16_t);
+constexpr std::size_t md_max_datagram_len_ = 1472; // ethernet mtu less ip and udp headers
+
+struct DatagramHeader {
+    char session[md_session_len_];
+    uint64_t sequence;
+    uint16_t count;
+};
+
+template<typename Data>
+void serialiseBytes(char*& ptr, Data data) {
+    std::memcpy(ptr, &data, sizeof(data));
+    ptr += sizeof(data);
+}
+
+// grows out by one record and returns where its payload goes
+inline char* appendRecord(std::string& out, uint8_t payload_len, char type) {
+    const std::size_t offset = out.size();
+    out.resize(offset + md_header_len_ + payload_len);
+    char* ptr = &out[offset];
+    *(ptr++) = payload_len;
+    *(ptr++) = type;
+    return ptr;
+}
+
+inline void writeDatagramHeader(char* datagram, const DatagramHeader& header) {
+    std::memcpy(datagram, header.session, md_session_len_);
+    char* ptr = datagram + md_session_len_;
+    serialiseBytes(ptr, header.sequence);
+    serialiseBytes(ptr, header.count);
+}
+
+inline DatagramHeader readDatagramHeader(const char* datagram) {
+    DatagramHeader header;
+    std::memcpy(header.session, datagram, md_session_len_);
+    std::memcpy(&header.sequence, datagram + md_session_len_, sizeof(header.sequence));
+    std::memcpy(&header.count, datagram + md_session_len_ + sizeof(header.sequence), sizeof(header.count));
+    return header;
+}
+
+// length of the whole record starting at record, header included
+inline std::size_t recordLength(const char* record) {
+    return md_header_len_ + static_cast<uint8_t>(record[0]);
+}
+}
+
+#endif
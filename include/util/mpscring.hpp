@@ -0,0 +1,88 @@
+#ifndef MPSC_RING_HPP
+#define MPSC_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "exception.hpp"
+
+namespace util {
+// Bounded lock-free Multi Producer Single Consumer ring of fixed-size commands.
+// Every cell carries a sequence number: producers claim a position with a CAS on
+// the enqueue counter and publish the cell by bumping its sequence, the consumer
+// only reads cells whose sequence says they are published. Producers never wait
+// on each other while copying, and each producer's pushes pop in the order made.
+template<typename T>
+class MPSCRing {
+public:
+    explicit MPSCRing(std::size_t capacity)
+        : mask_(capacity - 1)
+        , cells_(new Cell[capacity])
+    {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+            throw EngineException("MPSCRing capacity must be a power of two");
+        for (std::size_t i = 0; i < capacity; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    MPSCRing(const MPSCRing&) = delete;
+    MPSCRing& operator=(const MPSCRing&) = delete;
+    // false if the ring is full
+    bool tryPush(const T& item) {
+        Cell* cell;
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->item = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    // spins while the ring is full, back-pressuring the producer
+    void push(const T& item) {
+        while (!tryPush(item));
+    }
+    // consumer side only, false if the ring is empty
+    bool tryPop(T& item) {
+        Cell& cell = cells_[dequeue_pos_ & mask_];
+        const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeue_pos_ + 1) < 0)
+            return false;
+        item = cell.item;
+        cell.sequence.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+        ++dequeue_pos_;
+        return true;
+    }
+    std::size_t capacity() const {return mask_ + 1;}
+    // positions count every push and pop made so far, once the consumer's position reaches
+    // an earlier enqueue position everything claimed before it has been popped
+    std::size_t enqueuePosition() const {return enqueue_pos_.load(std::memory_order_acquire);}
+    std::size_t dequeuePosition() const {return dequeue_pos_;} // consumer side only
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "ring commands are copied in and out of cells");
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T item;
+    };
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<std::size_t> enqueue_pos_{0}; // producers and consumer on separate lines
+    alignas(64) std::size_t dequeue_pos_ = 0;
+};
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef NULL_MUTEX_HPP
+#define NULL_MUTEX_HPP
+
+namespace util {
+// satisfies Lockable for data only ever touched by one thread
+struct NullMutex {
+    void lock() {}
+    bool try_lock() {return true;}
+    void unlock() {}
+};
+}
+
+#endif
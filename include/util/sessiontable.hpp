@@ -0,0 +1,176 @@
+#ifndef SESSION_TABLE_HPP
+#define SESSION_TABLE_HPP
+
+#include <array>
+#include <cstdint>
+#include <shared_mutex>
+#include <mutex>
+#include <vector>
+
+namespace util {
+// Sharded user id -> session table, safe to use from any thread.
+// Each shard is an open addressed array behind its own reader/writer lock, sized up
+// front for the expected number of sessions so a connect storm only fills slots.
+// A shard only reallocates once it is more than half full.
+// visit() runs on the session under the shard's read lock, and erase() takes the write
+// lock, so a session erased before it is deleted is never used after it is deleted.
+// visitPinned() is for work that may wait: it pins the session under the lock and runs
+// after releasing it, so the owner must also wait for the session to be unpinned.
+template<typename Session>
+class SessionTable {
+public:
+    static constexpr std::size_t SHARD_BITS = 6;
+    static constexpr std::size_t NUM_SHARDS = 1ULL << SHARD_BITS;
+    explicit SessionTable(std::size_t expected_sessions = 4096) {
+        std::size_t slots = 8;
+        while (slots < 2 * expected_sessions / NUM_SHARDS)
+            slots <<= 1;
+        for (auto& shard : shards_)
+            shard.slots.resize(slots);
+    }
+    SessionTable(const SessionTable&) = delete;
+    SessionTable& operator=(const SessionTable&) = delete;
+    // false if the user id already has a session
+    bool insert(uint64_t user_id, Session* session) {
+        const uint64_t hash = mix(user_id);
+        Shard& shard = shards_[shardOf(hash)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (shard.find(user_id, hash) != NPOS)
+            return false;
+        if (2 * (shard.size + 1) > shard.slots.size())
+            shard.grow();
+        shard.place(user_id, hash, session);
+        ++shard.size;
+        return true;
+    }
+    // only removes the entry if it still belongs to this session
+    bool erase(uint64_t user_id, const Session* session) {
+        const uint64_t hash = mix(user_id);
+        Shard& shard = shards_[shardOf(hash)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        const std::size_t slot = shard.find(user_id, hash);
+        if (slot == NPOS || shard.slots[slot].session != session)
+            return false;
+        shard.remove(slot);
+        --shard.size;
+        return true;
+    }
+    bool contains(uint64_t user_id) const {
+        const uint64_t hash = mix(user_id);
+        const Shard& shard = shards_[shardOf(hash)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.find(user_id, hash) != NPOS;
+    }
+    // false if the user has no session, fn must not insert or erase
+    template<typename Fn>
+    bool visit(uint64_t user_id, Fn&& fn) const {
+        const uint64_t hash = mix(user_id);
+        const Shard& shard = shards_[shardOf(hash)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        const std::size_t slot = shard.find(user_id, hash);
+        if (slot == NPOS)
+            return false;
+        fn(*shard.slots[slot].session);
+        return true;
+    }
+    // false if the user has no session, Session needs pin() and unpin()
+    template<typename Fn>
+    bool visitPinned(uint64_t user_id, Fn&& fn) const {
+        Session* session;
+        {
+            const uint64_t hash = mix(user_id);
+            const Shard& shard = shards_[shardOf(hash)];
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            const std::size_t slot = shard.find(user_id, hash);
+            if (slot == NPOS)
+                return false;
+            session = shard.slots[slot].session;
+            session->pin();
+        }
+        fn(*session);
+        session->unpin();
+        return true;
+    }
+    // sessions may be erased as soon as this returns
+    std::vector<Session*> snapshot() const {
+        std::vector<Session*> sessions;
+        for (const auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto& slot : shard.slots) {
+                if (slot.session != nullptr)
+                    sessions.push_back(slot.session);
+            }
+        }
+        return sessions;
+    }
+    std::size_t size() const {
+        std::size_t size = 0;
+        for (const auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            size += shard.size;
+        }
+        return size;
+    }
+private:
+    static constexpr std::size_t NPOS = static_cast<std::size_t>(-1);
+    struct Slot {
+        uint64_t user_id = 0;
+        Session* session = nullptr; // null marks an empty slot
+    };
+    struct alignas(64) Shard {
+        std::size_t home(uint64_t hash) const {return hash & (slots.size() - 1);}
+        std::size_t find(uint64_t user_id, uint64_t hash) const {
+            const std::size_t mask = slots.size() - 1;
+            for (std::size_t i = home(hash); slots[i].session != nullptr; i = (i + 1) & mask) {
+                if (slots[i].user_id == user_id)
+                    return i;
+            }
+            return NPOS;
+        }
+        void place(uint64_t user_id, uint64_t hash, Session* session) {
+            const std::size_t mask = slots.size() - 1;
+            std::size_t i = home(hash);
+            while (slots[i].session != nullptr)
+                i = (i + 1) & mask;
+            slots[i] = {user_id, session};
+        }
+        // backward shift deletion, keeps every probe chain unbroken without tombstones
+        void remove(std::size_t hole) {
+            const std::size_t mask = slots.size() - 1;
+            for (std::size_t i = (hole + 1) & mask; slots[i].session != nullptr; i = (i + 1) & mask) {
+                const std::size_t ideal = home(mix(slots[i].user_id));
+                const bool stays = hole <= i ? (hole < ideal && ideal <= i) : (hole < ideal || ideal <= i);
+                if (stays)
+                    continue;
+                slots[hole] = slots[i];
+                hole = i;
+            }
+            slots[hole] = Slot();
+        }
+        void grow() {
+            std::vector<Slot> old(slots.size() * 2);
+            old.swap(slots);
+            for (const auto& slot : old) {
+                if (slot.session != nullptr)
+                    place(slot.user_id, mix(slot.user_id), slot.session);
+            }
+        }
+        mutable std::shared_mutex mutex;
+        std::vector<Slot> slots; // power of two
+        std::size_t size = 0;
+    };
+    // user ids are packed ascii, spread them over every bit before picking shard and slot
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+    static std::size_t shardOf(uint64_t hash) {return hash >> (64 - SHARD_BITS);}
+
+    std::array<Shard, NUM_SHARDS> shards_;
+};
+}
+
+#endif
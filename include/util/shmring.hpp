@@ -0,0 +1,176 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exception.hpp"
+
+namespace util {
+// Single producer, multi consumer broadcast ring of small records in a shared memory
+// file (shm_open, so it lives under /dev/shm). Records are numbered from 1 and each
+// slot carries the number of the record in it, zeroed while the producer rewrites it.
+// The producer never waits: a consumer that falls a capacity behind finds its slot
+// renumbered or mid-write, reports an overrun and skips ahead. Consumers keep their
+// position to themselves, so any number of them can read the same ring.
+class ShmRing {
+public:
+    static constexpr std::size_t SLOT_SIZE = 64;
+    static constexpr std::size_t RECORD_SIZE = SLOT_SIZE - sizeof(uint64_t) - 1;
+    enum class ReadResult {ok, empty, overrun};
+    // producer: replaces any ring left under name, capacity must be a power of two
+    ShmRing(const std::string& name, std::size_t capacity)
+        : name_(name)
+        , producer_(true)
+    {
+        if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+            throw EngineException("ShmRing capacity must be a power of two");
+        ::shm_unlink(name.c_str());
+        const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0)
+            throw EngineException("Failed to create shared memory ring " + name);
+        map(fd, sizeof(Header) + capacity * SLOT_SIZE, true);
+        header_->capacity = capacity;
+        header_->published.store(0, std::memory_order_relaxed);
+        header_->closed.store(0, std::memory_order_relaxed);
+        header_->magic.store(MAGIC, std::memory_order_release);
+    }
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+    ~ShmRing() {
+        ::munmap(header_, size_);
+        if (producer_)
+            ::shm_unlink(name_.c_str());
+    }
+    // consumer: nullptr until the producer has created and initialised the ring
+    static std::unique_ptr<ShmRing> attach(const std::string& name) {
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+            return nullptr;
+        struct ::stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header) + 2 * SLOT_SIZE) {
+            ::close(fd);
+            return nullptr;
+        }
+        std::unique_ptr<ShmRing> ring(new ShmRing(name));
+        if (!ring->map(fd, st.st_size, false))
+            return nullptr;
+        const Header& header = *ring->header_;
+        if (header.magic.load(std::memory_order_acquire) != MAGIC
+        || sizeof(Header) + header.capacity * SLOT_SIZE != ring->size_)
+            return nullptr;
+        ring->mask_ = header.capacity - 1;
+        return ring;
+    }
+    // producer only, len must be at most RECORD_SIZE
+    void publish(const char* record, std::size_t len) {
+        if (len > RECORD_SIZE)
+            throw EngineException("Record too large for shared memory ring");
+        const uint64_t number = ++next_;
+        Slot& slot = slots_[(number - 1) & mask_];
+        slot.number.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.len = static_cast<uint8_t>(len);
+        std::memcpy(slot.data, record, len);
+        slot.number.store(number, std::memory_order_release);
+        header_->published.store(number, std::memory_order_release);
+    }
+    // producer only, consumers stop once they have read everything published
+    void close() {header_->closed.store(1, std::memory_order_release);}
+    // consumer only, copies the next record into record, which holds RECORD_SIZE bytes
+    ReadResult read(char* record, std::size_t& len) {
+        const uint64_t number = next_ + 1;
+        const Slot& slot = slots_[(number - 1) & mask_];
+        uint64_t seen = slot.number.load(std::memory_order_acquire);
+        // an older number, or zero while the slot is being written: either the record
+        // is not out yet, or it was and may have been written over since
+        if (seen < number) {
+            if (header_->published.load(std::memory_order_acquire) < number)
+                return ReadResult::empty;
+            seen = slot.number.load(std::memory_order_acquire);
+        }
+        if (seen == number) {
+            len = slot.len;
+            std::memcpy(record, slot.data, RECORD_SIZE);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.number.load(std::memory_order_relaxed) == number && len <= RECORD_SIZE) {
+                next_ = number;
+                return ReadResult::ok;
+            }
+        }
+        skipAhead();
+        return ReadResult::overrun;
+    }
+    // consumer only, true once the producer has closed and everything was read
+    bool finished() const {
+        return header_->closed.load(std::memory_order_acquire)
+            && header_->published.load(std::memory_order_acquire) == next_;
+    }
+    uint64_t lost() const {return lost_;} // consumer only, records skipped after overruns
+    std::size_t capacity() const {return mask_ + 1;}
+private:
+    static constexpr uint64_t MAGIC = 0x4d44524e47303031; // MDRNG001
+    struct Header {
+        std::atomic<uint64_t> magic;
+        uint64_t capacity;
+        alignas(64) std::atomic<uint64_t> published; // number of the newest complete record
+        std::atomic<uint32_t> closed;
+    };
+    struct alignas(SLOT_SIZE) Slot {
+        std::atomic<uint64_t> number;
+        uint8_t len;
+        char data[RECORD_SIZE];
+    };
+    static_assert(sizeof(Slot) == SLOT_SIZE, "slots are one cache line");
+    static_assert(sizeof(Header) % SLOT_SIZE == 0, "slots start on a cache line");
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "atomics must work across processes");
+    explicit ShmRing(const std::string& name)
+        : name_(name)
+        , producer_(false)
+    {}
+    bool map(int fd, std::size_t size, bool create) {
+        if (create && ::ftruncate(fd, size) != 0) {
+            ::close(fd);
+            throw EngineException("Failed to size shared memory ring " + name_);
+        }
+        void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            if (create)
+                throw EngineException("Failed to map shared memory ring " + name_);
+            return false;
+        }
+        header_ = static_cast<Header*>(addr);
+        slots_ = reinterpret_cast<Slot*>(header_ + 1);
+        size_ = size;
+        mask_ = (size - sizeof(Header)) / SLOT_SIZE - 1;
+        return true;
+    }
+    // resumes half a ring behind the producer so the next reads are not overrun at once
+    void skipAhead() {
+        const uint64_t published = header_->published.load(std::memory_order_acquire);
+        const uint64_t resume = published > capacity() / 2 ? published - capacity() / 2 : 0;
+        if (resume > next_) {
+            lost_ += resume - next_;
+            next_ = resume;
+        }
+    }
+    std::string name_;
+    bool producer_;
+    Header* header_ = nullptr;
+    Slot* slots_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t mask_ = 0;
+    uint64_t next_ = 0; // producer: last number published, consumer: last number read
+    uint64_t lost_ = 0;
+};
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include <type_traits>
+
+namespace util {
+// Fixed-size object pool. Objects are carved out of slabs of SlabSize slots which are
+// never freed or moved, so addresses stay stable for the lifetime of the pool. Released
+// slots are threaded onto an intrusive free list (the next index is stored in the dead
+// slot itself), so a warm pool serves acquire/release without touching malloc.
+// Objects are addressed by a 32-bit index as well as by pointer.
+template<typename T, std::size_t SlabSize = 1024>
+class SlabPool {
+public:
+    using index = uint32_t;
+    static constexpr index NIL = static_cast<index>(-1);
+    explicit SlabPool(std::size_t prealloc = SlabSize) {
+        while (capacity() < prealloc)
+            addSlab();
+    }
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+    template<typename ...Args>
+    index acquire(Args&& ...args) {
+        if (free_head_ == NIL)
+            addSlab();
+        const index idx = free_head_;
+        void* slot = slotAddress(idx);
+        std::memcpy(&free_head_, slot, sizeof(index));
+        new (slot) T(std::forward<Args>(args)...);
+        ++live_;
+        return idx;
+    }
+    void release(const index idx) {
+        pushFree(idx);
+        --live_;
+    }
+    T& operator[](const index idx) {return *std::launder(reinterpret_cast<T*>(slotAddress(idx)));}
+    const T& operator[](const index idx) const {
+        return *std::launder(reinterpret_cast<const T*>(slotAddress(idx)));
+    }
+    std::size_t size() const {return live_;}
+    std::size_t capacity() const {return slabs_.size() * SlabSize;}
+private:
+    static_assert(std::is_trivially_destructible<T>::value, "slab slots are recycled without running destructors");
+    static_assert(sizeof(T) >= sizeof(index), "free list is threaded through released slots");
+    static_assert((SlabSize & (SlabSize - 1)) == 0, "slab size must be a power of two");
+    static constexpr std::size_t SLAB_SHIFT = __builtin_ctzll(SlabSize);
+    using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    void* slotAddress(const index idx) const {
+        return &slabs_[idx >> SLAB_SHIFT][idx & (SlabSize - 1)];
+    }
+    void pushFree(const index idx) {
+        std::memcpy(slotAddress(idx), &free_head_, sizeof(index));
+        free_head_ = idx;
+    }
+    void addSlab() {
+        const index first = static_cast<index>(capacity());
+        slabs_.emplace_back(new Slot[SlabSize]);
+        for (std::size_t i = SlabSize; i-- > 0;) // thread in reverse so slots hand out in address order
+            pushFree(first + i);
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+    index free_head_ = NIL;
+    std::size_t live_ = 0;
+};
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef SMALL_VECTOR_HPP
+#define SMALL_VECTOR_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+namespace util {
+// Append-only vector of trivially copyable T holding its first N elements inline.
+// Only growing past N touches the heap; the spilled buffer is kept across clear().
+template<typename T, std::size_t N>
+class SmallVector {
+public:
+    SmallVector() = default;
+    SmallVector(const SmallVector& rhs) {assign(rhs);}
+    SmallVector(SmallVector&& rhs) noexcept {steal(rhs);}
+    SmallVector& operator=(const SmallVector& rhs) {
+        if (this != &rhs) {
+            clear();
+            assign(rhs);
+        }
+        return *this;
+    }
+    SmallVector& operator=(SmallVector&& rhs) noexcept {
+        if (this != &rhs)
+            steal(rhs);
+        return *this;
+    }
+    template<typename ...Args>
+    T& emplace_back(Args&& ...args) {
+        if (size_ == capacity_)
+            grow(capacity_ * 2);
+        T* slot = new (data() + size_) T(std::forward<Args>(args)...);
+        ++size_;
+        return *slot;
+    }
+    void clear() {size_ = 0;}
+    T* data() {return heap_ ? std::launder(reinterpret_cast<T*>(heap_.get())) : std::launder(reinterpret_cast<T*>(inline_));}
+    const T* data() const {return const_cast<SmallVector*>(this)->data();}
+    T* begin() {return data();}
+    T* end() {return data() + size_;}
+    const T* begin() const {return data();}
+    const T* end() const {return data() + size_;}
+    T& operator[](std::size_t idx) {return data()[idx];}
+    const T& operator[](std::size_t idx) const {return data()[idx];}
+    std::size_t size() const {return size_;}
+    std::size_t capacity() const {return capacity_;}
+    bool empty() const {return size_ == 0;}
+    bool onHeap() const {return heap_ != nullptr;}
+private:
+    static_assert(std::is_trivially_copyable<T>::value, "elements are relocated with memcpy");
+    static_assert(std::is_trivially_destructible<T>::value, "elements are dropped without destructors");
+    using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+    void grow(std::size_t new_capacity) {
+        std::unique_ptr<Slot[]> grown(new Slot[new_capacity]);
+        std::memcpy(static_cast<void*>(grown.get()), data(), size_ * sizeof(T));
+        heap_ = std::move(grown);
+        capacity_ = new_capacity;
+    }
+    void assign(const SmallVector& rhs) {
+        if (rhs.size_ > capacity_)
+            grow(rhs.size_);
+        std::memcpy(static_cast<void*>(data()), rhs.data(), rhs.size_ * sizeof(T));
+        size_ = rhs.size_;
+    }
+    void steal(SmallVector& rhs) {
+        if (rhs.heap_) {
+            heap_ = std::move(rhs.heap_);
+            capacity_ = rhs.capacity_;
+            size_ = rhs.size_;
+        }
+        else {
+            clear();
+            assign(rhs);
+        }
+        rhs.capacity_ = N;
+        rhs.size_ = 0;
+    }
+
+    Slot inline_[N];
+    std::unique_ptr<Slot[]> heap_;
+    std::size_t size_ = 0;
+    std::size_t capacity_ = N;
+};
+}
+
+#endif
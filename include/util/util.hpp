@@ -9,6 +9,7 @@
 #include <sstream>
 #include <iomanip>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 
 // misc utility functions
@@ -84,6 +85,14 @@ static inline std::string getTimeStringFromTimestamp(int64_t timestamp) {
     return std::to_string(hours) + ":" + minstr
         + ":" + secstr;
 }
+// false if the calling thread could not be pinned to the cpu
+static inline bool pinThisThread(uint32_t cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+}
+
 static inline uint16_t getTerminalWidth() {
     struct winsize w;
     ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
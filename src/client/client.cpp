@@ -54,17 +54,33 @@ void TradingClient::readMarketData() {
     socket_.async_receive_from(
         boost::asio::buffer(buffer_),
         marketdata_platform_,
-        [this](boost::system::error_code ec, std::size_t){
-            if (!ec) {
-                data_length_ = buffer_[0];
-                packet_type_ = buffer_[1];
-                processMarketData();
-            }
+        [this](boost::system::error_code ec, std::size_t received){
+            if (!ec)
+                processDatagram(received);
             readMarketData();
         }
     );
 }
 
+// records sit back to back after the header, a truncated one ends the datagram. Each
+// is copied out before being cast, as the feed handler writes past the end of adds.
+void TradingClient::processDatagram(std::size_t received) {
+    if (received < util::md_datagram_header_len_)
+        return;
+    const util::DatagramHeader header = util::readDatagramHeader(buffer_);
+    std::size_t offset = util::md_datagram_header_len_;
+    for (uint16_t i = 0; i < header.count && offset + HEADER_LEN <= received; ++i) {
+        const std::size_t len = util::recordLength(buffer_ + offset);
+        if (offset + len > received || len > sizeof(record_))
+            return;
+        std::memcpy(record_, buffer_ + offset, len);
+        offset += len;
+        data_length_ = record_[0];
+        packet_type_ = record_[1];
+        processMarketData();
+    }
+}
+
 void TradingClient::processMarketData() {
     switch(packet_type_) {
         case 'A':
@@ -73,6 +89,9 @@ void TradingClient::processMarketData() {
         case 'M':
             processModifyOrderData();
             break;
+        case 'R':
+            processReplaceOrderData();
+            break;
         case 'C':
             processCancelOrderData();
             break;
@@ -82,6 +101,9 @@ void TradingClient::processMarketData() {
         case 'N':
             processNotificationData();
             break;
+        case 'S':
+            processInstrumentData();
+            break;
         default:
             std::cout << "incorrect type" << std::endl;
             break;
@@ -89,17 +111,17 @@ void TradingClient::processMarketData() {
 }
 
 void TradingClient::processAddOrderData() {
-    AddOrderData* add_order = reinterpret_cast<AddOrderData*>(buffer_ + HEADER_LEN);
+    AddOrderData* add_order = reinterpret_cast<AddOrderData*>(record_ + HEADER_LEN);
     feedhandler_.addOrder(add_order);
     if (subscription_ != nullptr) {
-        if (subscription_->getTicker() == add_order->ticker) {
+        if (subscription_->getTicker() == feedhandler_.symbol(add_order->instrument_id)) {
             reprintInterface();
         }
     }
 }
 
 void TradingClient::processModifyOrderData() {
-    ModOrderData* mod_order = reinterpret_cast<ModOrderData*>(buffer_ + HEADER_LEN);
+    ModOrderData* mod_order = reinterpret_cast<ModOrderData*>(record_ + HEADER_LEN);
     feedhandler_.modifyOrder(mod_order);
     if (subscription_ != nullptr) {
         auto tkr = feedhandler_.getOrderIDTicker(mod_order->order_id);
@@ -109,8 +131,19 @@ void TradingClient::processModifyOrderData() {
     }
 }
 
+void TradingClient::processReplaceOrderData() {
+    ReplaceOrderData* replace_order = reinterpret_cast<ReplaceOrderData*>(record_ + HEADER_LEN);
+    feedhandler_.replaceOrder(replace_order);
+    if (subscription_ != nullptr) {
+        auto tkr = feedhandler_.getOrderIDTicker(replace_order->order_id);
+        if (subscription_->getTicker() == tkr) {
+            reprintInterface();
+        }
+    }
+}
+
 void TradingClient::processCancelOrderData() {
-    CancelOrderData* cancel_order = reinterpret_cast<CancelOrderData*>(buffer_ + HEADER_LEN);
+    CancelOrderData* cancel_order = reinterpret_cast<CancelOrderData*>(record_ + HEADER_LEN);
     feedhandler_.cancelOrder(cancel_order);
     if (subscription_ != nullptr) {
         auto tkr = feedhandler_.getOrderIDTicker(cancel_order->order_id);
@@ -121,10 +154,10 @@ void TradingClient::processCancelOrderData() {
 }
 
 void TradingClient::processFillOrderData() {
-    FillOrderData* fill = reinterpret_cast<FillOrderData*>(buffer_ + HEADER_LEN);
+    FillOrderData* fill = reinterpret_cast<FillOrderData*>(record_ + HEADER_LEN);
     feedhandler_.fillOrder(fill);
     if (subscription_ != nullptr) {
-        if (subscription_->getTicker() == fill->ticker) {
+        if (subscription_->getTicker() == feedhandler_.symbol(fill->instrument_id)) {
             reprintInterface();
         }
     }
@@ -134,6 +167,11 @@ void TradingClient::processNotificationData() {
 
 }
 
+void TradingClient::processInstrumentData() {
+    InstrumentData* instrument = reinterpret_cast<InstrumentData*>(record_ + HEADER_LEN);
+    feedhandler_.defineInstrument(instrument);
+}
+
 void TradingClient::interpretResponseType(OEResponse& oe_response) {
     switch(oe_response.OrderStatusType_case()) {
         case AckType::kNewOrderAck:
@@ -207,7 +245,7 @@ void TradingClient::promptUserID() {
 void TradingClient::interpretAck(const NewOrderAck& new_ack) {
     const auto& ord = new_ack.new_order();
     std::string side = ord.is_buy_side() == 1 ? "BID" : "ASK";
-    std::string tkr = util::convertEightBytesToString(ord.order_common().ticker());
+    std::string tkr = tickerStr(ord.order_common().instrument_id());
     info_feed_.push_back(
         timestampStr(new_ack.timestamp())
         + "ADD " + side + " TO " + tkr + " "
@@ -221,7 +259,7 @@ void TradingClient::interpretAck(const NewOrderAck& new_ack) {
 
 void TradingClient::interpretAck(const ModOrderAck& mod_ack) {
     const auto& ord = mod_ack.modify_order();
-    std::string tkr = util::convertEightBytesToString(ord.order_common().ticker());
+    std::string tkr = tickerStr(ord.order_common().instrument_id());
     auto curr_ord = feedhandler_.getOrder(ord.order_common().order_id());
     std::string side = ord.is_buy_side() == 1 ? "BID" : "ASK";
     info_feed_.push_back(
@@ -238,7 +276,7 @@ void TradingClient::interpretAck(const ModOrderAck& mod_ack) {
 void TradingClient::interpretAck(const CancelOrderAck& cancel_ack) {
     const auto& ord = cancel_ack.status_common();
     auto curr_ord = feedhandler_.getOrder(ord.order_id());
-    std::string tkr = util::convertEightBytesToString(ord.ticker());
+    std::string tkr = tickerStr(ord.instrument_id());
     std::string side = curr_ord->is_buy_side == 1 ? "BID" : "ASK";
     info_feed_.push_back(
         timestampStr(cancel_ack.timestamp())
@@ -256,7 +294,7 @@ void TradingClient::interpretAck(const FillAck& fill_ack) {
         std::string side;
         if (curr_ord != nullptr)
             side = curr_ord->is_buy_side == 1 ? "BID" : "ASK";
-        std::string tkr = util::convertEightBytesToString(ord.ticker());
+        std::string tkr = tickerStr(ord.instrument_id());
         info_feed_.push_back(
             timestampStr(fill_ack.timestamp())
             + side + " ORDER " + std::to_string(ord.order_id())
@@ -277,7 +315,19 @@ void TradingClient::interpretAck(const RejectAck& reject_ack) {
 
 std::string TradingClient::commonStr(const Common& common) {
     return "ORDER: " + std::to_string(common.order_id()) + " TICKER: " 
-        + util::convertEightBytesToString(common.ticker());
+        + tickerStr(common.instrument_id());
+}
+
+std::string TradingClient::tickerStr(uint32_t instrument_id) const {
+    return util::convertEightBytesToString(feedhandler_.symbol(instrument_id));
+}
+
+bool TradingClient::setInstrument(Common* common, const std::string& ticker) const {
+    const auto instrument_id = feedhandler_.instrumentID(util::convertStrToEightBytes(ticker));
+    if (instrument_id == NO_INSTRUMENT)
+        return false;
+    common->set_instrument_id(instrument_id);
+    return true;
 }
 
 std::string TradingClient::commonStr(int64_t timestamp, const Common& common) {
@@ -389,7 +439,8 @@ bool TradingClient::constructNewOrderRequest(OERequest& request, const std::stri
         return false;
     neworder->set_price(std::stoi(values[1]));
     neworder->set_quantity(std::stoi(values[2]));
-    common->set_ticker(util::convertStrToEightBytes(values[3]));
+    if (!setInstrument(common, values[3]))
+        return false;
     common->set_user_id(userID_);
     common->set_order_id(0);
     return true;
@@ -405,7 +456,8 @@ bool TradingClient::constructModifyOrderRequest(OERequest& request, const std::s
         return false;
     modorder->set_price(std::stoi(values[1]));
     modorder->set_quantity(std::stoi(values[2]));
-    common->set_ticker(util::convertStrToEightBytes(values[3]));
+    if (!setInstrument(common, values[3]))
+        return false;
     common->set_user_id(userID_);
     common->set_order_id(std::stoi(values[5]));
     return true;
@@ -417,7 +469,8 @@ bool TradingClient::constructCancelOrderRequest(OERequest& request, const std::s
     std::vector<std::string> values(getOrderValues(input, cancelorder_fields_));
     if (values.empty())
         return false;
-    common->set_ticker(util::convertStrToEightBytes(values[0]));
+    if (!setInstrument(common, values[0]))
+        return false;
     common->set_user_id(userID_);
     common->set_order_id(std::stoi(values[2]));
     return true;
@@ -2,108 +2,106 @@
 
 using namespace dataplatform;
 
-DataPlatform::DataPlatform(std::shared_ptr<grpc::Channel> channel) 
+DataPlatform::DataPlatform(std::shared_ptr<grpc::Channel> channel,
+std::chrono::microseconds flush_interval) 
     : stub_(orderentry::MarketDataService::NewStub(channel))
     , socket_(io_context, udp::endpoint(udp::v4(), 9002))
-{}
+    , flush_interval_(flush_interval)
+{
+    // start time in seconds, ten digits until 2286
+    const std::string session = std::to_string(
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count()
+    );
+    std::memset(session_, ' ', sizeof(session_));
+    std::memcpy(session_, session.data(), std::min(session.size(), sizeof(session_)));
+}
 
 void DataPlatform::initiateMarketDataStream() {
     acceptSubscriber();
     std::thread acceptloop([this](){io_context.run();});
-    std::unique_ptr<grpc::ClientReader<MDResponse>> market_data_reader(
+    std::unique_ptr<grpc::ClientReader<MDBatch>> market_data_reader(
         stub_->MarketData(&context_, MDRequest())
     );
-    while (market_data_reader->Read(&market_data_)) {
-        serialiseMarketData();
-        for (const auto& subscriber : subscribers_) {
-            socket_.async_send_to(
-                boost::asio::buffer(temp_buffer_, temp_buffer_[0] + 2),
-                subscriber,
-                [this, subscriber](boost::system::error_code ec, std::size_t) {
-                    if (ec) {
-                        this->subscribers_.erase(
-                            std::find(
-                                subscribers_.begin(), 
-                                subscribers_.end(),
-                                subscriber
-                            )
-                        );
-                    }
-                }
-            );
+    while (market_data_reader->Read(&market_data_batch_)) {
+        const std::string& records = market_data_batch_.records();
+        for (std::size_t offset = 0; offset < records.size();) {
+            const std::size_t len = util::recordLength(records.data() + offset);
+            forwardRecord(records.data() + offset, len);
+            offset += len;
         }
+        flushDatagram();
     }
     acceptloop.join();
 }
 
-void DataPlatform::serialiseMarketData() {
-    switch(market_data_.OrderEntryType_case()) {
-        case type::kAdd:
-            serialiseAddOrder();
-            break;
-        case type::kCancel:
-            serialiseCancel();
-            break;
-        case type::kFill:
-            serialiseFill();
-            break;
-        case type::kMod:
-            serialiseModOrder();
-            break;
-        case type::kNotification:
-            serialiseNotification();
-            break;
-        case type::ORDERENTRYTYPE_NOT_SET:
-            break;
+void DataPlatform::initiateSharedMemoryStream(const std::string& name) {
+    acceptSubscriber();
+    std::thread acceptloop([this](){io_context.run();});
+    std::unique_ptr<util::ShmRing> bus;
+    while (!(bus = util::ShmRing::attach(name)))
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::size_t len;
+    uint64_t lost = 0;
+    while (!bus->finished()) {
+        switch (bus->read(bus_record_.data(), len)) {
+            case util::ShmRing::ReadResult::ok:
+                forwardRecord(bus_record_.data(), len);
+                break;
+            case util::ShmRing::ReadResult::overrun:
+                // subscribers see the lost records as a gap in sequence numbers
+                flushDatagram();
+                next_sequence_ += bus->lost() - lost;
+                lost = bus->lost();
+                std::cerr << "market data bus overrun, " << lost << " records lost so far\n";
+                break;
+            case util::ShmRing::ReadResult::empty:
+                break;
+        }
+        if (datagram_.count > 0 && Clock::now() - first_pending_ >= flush_interval_)
+            flushDatagram();
     }
+    flushDatagram();
+    io_context.stop();
+    acceptloop.join();
 }
 
-void DataPlatform::serialiseAddOrder() {
-    char* temp_ptr = temp_buffer_.data();
-    *(temp_ptr++) = add_data_len_;
-    *(temp_ptr++) = 'A';
-    serialiseBytes(temp_ptr, market_data_.add().timestamp());
-    serialiseBytes(temp_ptr, market_data_.add().order_id());
-    serialiseBytes(temp_ptr, market_data_.add().ticker());
-    serialiseBytes(temp_ptr, market_data_.add().price());
-    serialiseBytes(temp_ptr, market_data_.add().quantity());
-    serialiseBytes(temp_ptr, market_data_.add().is_buy_side());
-}
-
-void DataPlatform::serialiseModOrder() {
-    char* temp_ptr = temp_buffer_.data();
-    *(temp_ptr++) = mod_data_len_;
-    *(temp_ptr++) = 'M';
-    serialiseBytes(temp_ptr, market_data_.mod().timestamp());
-    serialiseBytes(temp_ptr, market_data_.mod().order_id());
-    serialiseBytes(temp_ptr, market_data_.mod().quantity());
-}
-
-void DataPlatform::serialiseFill() {
-    char* temp_ptr = temp_buffer_.data();
-    *(temp_ptr++) = fill_data_len_;
-    *(temp_ptr++) = 'F';
-    serialiseBytes(temp_ptr, market_data_.fill().timestamp());
-    serialiseBytes(temp_ptr, market_data_.fill().status_common().order_id());
-    serialiseBytes(temp_ptr, market_data_.fill().status_common().ticker());
-    serialiseBytes(temp_ptr, market_data_.fill().fill_id());
-    serialiseBytes(temp_ptr, market_data_.fill().fill_quantity());
-}
-
-void DataPlatform::serialiseNotification() {
-    char* temp_ptr = temp_buffer_.data();
-    *(temp_ptr++) = notification_len_;
-    *(temp_ptr++) = 'N';
-    serialiseBytes(temp_ptr, market_data_.notification().timestamp());
-    serialiseBytes(temp_ptr, market_data_.notification().flag());
+// records arrive already encoded by the server, only instruments are kept for replay
+void DataPlatform::forwardRecord(const char* record, std::size_t len) {
+    if (record[1] == 'S') {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        instruments_.emplace_back(record, len);
+    }
+    if (datagram_.len + len > datagram_.bytes.size())
+        flushDatagram();
+    if (datagram_.count == 0)
+        first_pending_ = Clock::now();
+    std::memcpy(datagram_.bytes.data() + datagram_.len, record, len);
+    datagram_.len += len;
+    ++datagram_.count;
 }
 
-void DataPlatform::serialiseCancel() {
-    char* temp_ptr = temp_buffer_.data();
-    *(temp_ptr++) = cancel_data_len_;
-    *(temp_ptr++) = 'C';
-    serialiseBytes(temp_ptr, market_data_.cancel().timestamp());
-    serialiseBytes(temp_ptr, market_data_.cancel().order_id());
+// UDP sends copy into the kernel, so the datagram can be reused as soon as they return
+void DataPlatform::flushDatagram() {
+    if (datagram_.count == 0)
+        return;
+    util::DatagramHeader header;
+    std::memcpy(header.session, session_, sizeof(session_));
+    header.sequence = next_sequence_;
+    header.count = datagram_.count;
+    util::writeDatagramHeader(datagram_.bytes.data(), header);
+    next_sequence_ += datagram_.count;
+    {
+        std::lock_guard<std::mutex> lock(subscribers_mutex_);
+        boost::system::error_code ec;
+        for (auto it = subscribers_.begin(); it != subscribers_.end();) {
+            socket_.send_to(boost::asio::buffer(datagram_.bytes.data(), datagram_.len), *it, 0, ec);
+            it = ec ? subscribers_.erase(it) : std::next(it);
+        }
+    }
+    datagram_.len = util::md_datagram_header_len_;
+    datagram_.count = 0;
 }
 
 void DataPlatform::acceptSubscriber() {
@@ -112,9 +110,36 @@ void DataPlatform::acceptSubscriber() {
         temp_remote_endpoint_,
         [this](boost::system::error_code ec, std::size_t) {
             if (!ec) {
-                this->subscribers_.insert(this->temp_remote_endpoint_);
+                this->addSubscriber(this->temp_remote_endpoint_);
                 this->acceptSubscriber();
             }
         }
     );
 }
+
+// the symbol directory goes out unsequenced before the subscriber sees any orders
+void DataPlatform::addSubscriber(const udp::endpoint& subscriber) {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    Datagram replay;
+    util::DatagramHeader header;
+    std::memcpy(header.session, session_, sizeof(session_));
+    header.sequence = 0;
+    boost::system::error_code ec;
+    auto send = [&]() {
+        header.count = replay.count;
+        util::writeDatagramHeader(replay.bytes.data(), header);
+        socket_.send_to(boost::asio::buffer(replay.bytes.data(), replay.len), subscriber, 0, ec);
+        replay.len = util::md_datagram_header_len_;
+        replay.count = 0;
+    };
+    for (const auto& instrument : instruments_) {
+        if (replay.len + instrument.size() > replay.bytes.size())
+            send();
+        std::memcpy(replay.bytes.data() + replay.len, instrument.data(), instrument.size());
+        replay.len += instrument.size();
+        ++replay.count;
+    }
+    if (replay.count > 0)
+        send();
+    subscribers_.insert(subscriber);
+}
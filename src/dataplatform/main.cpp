@@ -3,11 +3,17 @@
 int main(int argc, char* argv[]) {
     if (argc < 3)
         return 1;
+    // [host] [port] [OPTIONAL: shared memory bus name] [OPTIONAL: bus flush interval us]
     dataplatform::DataPlatform dp(
         grpc::CreateChannel(
             std::string(std::string(argv[1], strlen(argv[1])) + ":" + argv[2]),
             grpc::InsecureChannelCredentials()
-        )
+        ),
+        argc >= 5 ? std::chrono::microseconds(std::stoul(argv[4]))
+            : dataplatform::DataPlatform::DEFAULT_FLUSH_INTERVAL
     );
-    dp.initiateMarketDataStream();
+    if (argc >= 4)
+        dp.initiateSharedMemoryStream(argv[3]);
+    else
+        dp.initiateMarketDataStream();
 }
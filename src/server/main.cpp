@@ -2,9 +2,24 @@
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cout << "Call with correct args: [port] [OPTIONAL: log file]" << std::endl;
+        std::cout << "Call with correct args: [port] [OPTIONAL: log file] [OPTIONAL: matching threads] [OPTIONAL: rpc threads] [OPTIONAL: pin rpc threads 0/1] [OPTIONAL: slow consumer policy coalesce/disconnect/block] [OPTIONAL: shared memory market data bus name] [OPTIONAL: pin matching threads 0/1, default 1] [OPTIONAL: admin address, default 127.0.0.1:port+1] [OPTIONAL: price ladder ticks per book side, default 1024]" << std::endl;
         return 1;
     }
-    server::TradeServer server(argv[1], argc == 3 ? argv[2] : "");
+    uint32_t matching_threads = argc >= 4 ? std::stoul(argv[3]) : 0;
+    uint32_t rpc_threads = argc >= 5 ? std::stoul(argv[4]) : 0;
+    bool pin_rpc_threads = argc >= 6 && std::stoul(argv[5]) != 0;
+    bool pin_matching_threads = argc < 9 || std::stoul(argv[8]) != 0;
+    uint32_t ladder_ticks = argc >= 11 ? std::stoul(argv[10]) : server::TradeServer::DEFAULT_LADDER_TICKS;
+    OutboundLimits outbound_limits;
+    if (argc >= 7) {
+        const std::string policy = argv[6];
+        if (policy == "disconnect")
+            outbound_limits.policy = SlowConsumerPolicy::disconnect;
+        else if (policy == "block")
+            outbound_limits.policy = SlowConsumerPolicy::block;
+    }
+    server::TradeServer server(argv[1], argc >= 3 ? argv[2] : "", matching_threads,
+        rpc_threads, pin_rpc_threads, outbound_limits, argc >= 8 ? argv[7] : "", pin_matching_threads,
+        argc >= 10 ? argv[9] : "", ladder_ticks);
     return 0;
 }
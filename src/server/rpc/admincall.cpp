@@ -0,0 +1,46 @@
+#include "admincall.hpp"
+
+using namespace rpc;
+
+AdminCall::AdminCall(AdminServiceType* service, grpc::ServerCompletionQueue* cq,
+const AdminHandlers& handlers)
+    : service_(service)
+    , cq_(cq)
+    , handlers_(handlers)
+    , responder_(&server_context_)
+{
+    process_request_cb_ = [this](bool success){this->processRequest(success);};
+    on_finish_cb_ = [this](bool success){this->onFinish(success);};
+    service_->RequestInstrument(&server_context_, &request_, &responder_, cq_, cq_, &process_request_cb_);
+}
+
+void AdminCall::processRequest(bool success) {
+    if (!success) { // server shutting down
+        delete this;
+        return;
+    }
+    new AdminCall(service_, cq_, handlers_);
+    bool done = false;
+    switch (request_.action()) {
+        case InstrumentRequestType::create:
+            done = handlers_.create_orderbook_fn(request_.symbol(), request_.ladder_ticks());
+            break;
+        case InstrumentRequestType::retire:
+            done = handlers_.retire_orderbook_fn(request_.symbol());
+            break;
+        default:
+            break;
+    }
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Admin instrument request from", server_context_.peer(),
+        "for", util::ShortString(request_.symbol()), done ? "succeeded" : "failed"
+    );
+    response_.set_success(done);
+    responder_.Finish(response_, grpc::Status::OK, &on_finish_cb_);
+}
+
+void AdminCall::onFinish(bool) {
+    delete this;
+}
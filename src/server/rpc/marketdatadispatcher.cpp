@@ -11,9 +11,26 @@ orderentry::MarketDataService::AsyncService* market_data_service)
     write_marketdata_ = [this](bool success) {
         this->writeToMDPlatform(success);
     };
+    for (auto& batch : batches_)
+        batch.message.mutable_records()->reserve(BATCH_RESERVE);
+}
+
+void MarketDataDispatcher::useSharedMemoryBus(const std::string& name) {
+    bus_.reset(new util::ShmRing(name, BUS_CAPACITY));
 }
 
 bool MarketDataDispatcher::initiateMarketDataDispatch() {
+    if (bus_) {
+        logging::Logger::Log(
+            logging::LogType::Info,
+            util::getLogTimestamp(),
+            "Publishing market data on the shared memory bus"
+        );
+        stream_ok_ = true;
+        running_.store(true);
+        thread_ = std::thread([this](){run();});
+        return true;
+    }
     market_data_service_->RequestMarketData(
         &server_context_,
         &md_request_,
@@ -35,32 +52,170 @@ bool MarketDataDispatcher::initiateMarketDataDispatch() {
         util::getLogTimestamp(),
         "Market data dispatcher connection successful"
     );
+    // without a stream the dispatcher still runs, dropping events so publishers never stall
+    stream_ok_ = ok;
+    running_.store(true);
+    thread_ = std::thread([this](){run();});
     return ok;
 }
 
-void MarketDataDispatcher::writeMarketData(const MDResponseType* marketdata) {
-    if (marketdata->add().order_id() == 356198) {
-        auto t1 = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double, std::milli> time = t1 - OrderEntryStreamConnection::t0;
-        std::cout << "BENCHMARK COMPLETE: " << std::endl;
-        std::cout << "120000 orders in " << (time / 1000.0).count() << " seconds" << std::endl;
-        std::cout << 120000.0 / (time / 1000.0).count() << " orders a second" << std::endl;
-        exit(0);
+// the thread's ring is looked up once and cached
+MarketDataDispatcher::Publisher& MarketDataDispatcher::publisher() {
+    thread_local const MarketDataDispatcher* owner = nullptr;
+    thread_local Publisher* cached = nullptr;
+    if (owner == this)
+        return *cached;
+    std::lock_guard<std::mutex> lock(publishers_mutex_);
+    const std::size_t index = num_publishers_.load(std::memory_order_relaxed);
+    if (index == MAX_PUBLISHERS)
+        throw EngineException("Too many threads publishing market data");
+    publishers_[index].reset(new Publisher());
+    num_publishers_.store(index + 1, std::memory_order_release);
+    owner = this;
+    cached = publishers_[index].get();
+    return *cached;
+}
+
+void MarketDataDispatcher::publish(const MarketDataEvent& event) {
+    publisher().ring.push(event);
+}
+
+void MarketDataDispatcher::flushThisThread() {
+    Publisher& self = publisher();
+    const std::size_t published = self.ring.enqueuePosition();
+    while (running_.load(std::memory_order_acquire)
+    && self.taken.load(std::memory_order_acquire) < published)
+        std::this_thread::yield();
+}
+
+void MarketDataDispatcher::stop() {
+    if (!running_.exchange(false))
+        return;
+    thread_.join();
+    if (bus_)
+        bus_->close();
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Market data batch sizes", batch_sizes_.toString()
+    );
+}
+
+void MarketDataDispatcher::run() {
+    for (;;) {
+        // read before draining, so an idle pass after it has seen everything published
+        const bool stopping = !running_.load(std::memory_order_acquire);
+        bool idle = true;
+        if (write_in_progress_ && write_done_.load(std::memory_order_acquire)) {
+            write_done_.store(false, std::memory_order_relaxed);
+            write_in_progress_ = false;
+            batches_[filling_ ^ 1].message.clear_records();
+            batches_[filling_ ^ 1].events = 0;
+            stream_ok_ = stream_ok_ && write_ok_.load(std::memory_order_relaxed);
+            idle = false;
+        }
+        Batch& batch = batches_[filling_];
+        const std::size_t num_publishers = num_publishers_.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < num_publishers; ++i)
+            idle = !drain(*publishers_[i], batch) && idle;
+        if (bus_ && batch.events > 0)
+            publishToBus(batch);
+        else if (!write_in_progress_ && batch.events > 0) {
+            batch_sizes_.record(batch.events);
+            write_in_progress_ = true;
+            market_data_writer_.Write(batch.message, &write_marketdata_);
+            filling_ ^= 1;
+        }
+        if (!idle)
+            continue;
+        if (stopping && !write_in_progress_)
+            return;
+        std::this_thread::yield();
     }
-    std::lock_guard<std::mutex> lock(mdmutex_);
-    market_data_queue_.push_back(*marketdata);
-    if (!write_in_progress_) {
-        market_data_writer_.Write(*marketdata, &write_marketdata_);
-        write_in_progress_ = true;
+}
+
+// takes a bounded run from one ring so a busy thread cannot starve the others,
+// false if nothing was taken. Without a stream events are taken and dropped.
+bool MarketDataDispatcher::drain(Publisher& publisher, Batch& batch) {
+    constexpr std::size_t MAX_RUN = 256;
+    MarketDataEvent event;
+    std::size_t taken = 0;
+    std::string& records = *batch.message.mutable_records();
+    while (taken < MAX_RUN && batch.events < MAX_BATCH && publisher.ring.tryPop(event)) {
+        if (stream_ok_) {
+            encode(event, records);
+            ++batch.events;
+        }
+        ++taken;
     }
+    if (taken == 0)
+        return false;
+    publisher.taken.store(publisher.ring.dequeuePosition(), std::memory_order_release);
+    return true;
 }
 
-void MarketDataDispatcher::writeToMDPlatform(bool success) {
-    std::lock_guard<std::mutex> lock(mdmutex_);
-    market_data_queue_.pop_front();
-    if (!market_data_queue_.empty() && success) {
-        market_data_writer_.Write(market_data_queue_.front(), &write_marketdata_);
+void MarketDataDispatcher::publishToBus(Batch& batch) {
+    batch_sizes_.record(batch.events);
+    const std::string& records = batch.message.records();
+    for (std::size_t offset = 0; offset < records.size();) {
+        const std::size_t len = util::recordLength(records.data() + offset);
+        bus_->publish(records.data() + offset, len);
+        offset += len;
     }
-    else
-        write_in_progress_ = false;
+    batch.message.clear_records();
+    batch.events = 0;
+}
+
+// layouts match what subscribers cast the datagrams to, see client/marketdatatypes.hpp
+void MarketDataDispatcher::encode(const MarketDataEvent& event, std::string& records) {
+    using Type = MarketDataEvent::Type;
+    char* ptr;
+    switch (event.type) {
+        case Type::add:
+            ptr = util::appendRecord(records, util::add_data_len_, 'A');
+            util::serialiseBytes(ptr, event.timestamp);
+            util::serialiseBytes(ptr, event.order_id);
+            util::serialiseBytes(ptr, event.price);
+            util::serialiseBytes(ptr, event.instrument_id);
+            util::serialiseBytes(ptr, event.quantity);
+            util::serialiseBytes(ptr, static_cast<bool>(event.flag));
+            break;
+        case Type::modify:
+            ptr = util::appendRecord(records, util::mod_data_len_, 'M');
+            util::serialiseBytes(ptr, event.timestamp);
+            util::serialiseBytes(ptr, event.order_id);
+            util::serialiseBytes(ptr, event.quantity);
+            break;
+        case Type::replace:
+            ptr = util::appendRecord(records, util::replace_data_len_, 'R');
+            util::serialiseBytes(ptr, event.timestamp);
+            util::serialiseBytes(ptr, event.order_id);
+            util::serialiseBytes(ptr, event.price);
+            util::serialiseBytes(ptr, event.quantity);
+            break;
+        case Type::cancel:
+            ptr = util::appendRecord(records, util::cancel_data_len_, 'C');
+            util::serialiseBytes(ptr, event.timestamp);
+            util::serialiseBytes(ptr, event.order_id);
+            break;
+        case Type::fill:
+            ptr = util::appendRecord(records, util::fill_data_len_, 'F');
+            util::serialiseBytes(ptr, event.timestamp);
+            util::serialiseBytes(ptr, event.order_id);
+            util::serialiseBytes(ptr, uint64_t{0}); // fill_id, not assigned yet
+            util::serialiseBytes(ptr, event.instrument_id);
+            util::serialiseBytes(ptr, event.quantity);
+            break;
+        case Type::instrument:
+            ptr = util::appendRecord(records, util::instrument_data_len_, 'S');
+            util::serialiseBytes(ptr, event.price);
+            util::serialiseBytes(ptr, event.instrument_id);
+            break;
+    }
+}
+
+// completion queue thread, the dispatcher thread picks the result up
+void MarketDataDispatcher::writeToMDPlatform(bool success) {
+    write_ok_.store(success, std::memory_order_relaxed);
+    write_done_.store(true, std::memory_order_release);
 }
@@ -0,0 +1,104 @@
+#include "orderentryeventsink.hpp"
+
+using namespace rpc;
+
+thread_local orderentry::OrderEntryResponse OrderEntryEventSink::orderfill_ack;
+
+void OrderEntryEventSink::onAdd(const ::tradeorder::Order& order) {
+    logging::Logger::Log(
+        logging::LogType::Info, 
+        util::getLogTimestamp(), 
+        "Order added with ID:", order.getOrderID(), 
+        "User ID:", util::ShortString(order.getUserID()), 
+        "Instrument:", order.getTicker(),
+        "Price:", order.getPrice(), 
+        "Quantity:", order.getCurrQty()
+    );
+    md_dispatch_->publish({MarketDataEvent::Type::add, order.isBuySide(), order.getCurrQty(),
+        static_cast<uint32_t>(order.getTicker()), util::getUnixTimestamp(), order.getOrderID(),
+        order.getPrice(), 0});
+}
+
+// the fill is either side of a match, it names its own order and owner
+void OrderEntryEventSink::onFill(const info::Fill& fill, const ::tradeorder::Order&) {
+    auto fill_ack = orderfill_ack.mutable_fill();
+    fill_ack->set_timestamp(fill.timestamp);
+    fill_ack->set_fill_quantity(fill.fill_qty);
+    fill_ack->set_complete_fill(fill.full_fill);
+    auto common = fill_ack->mutable_status_common();
+    common->set_order_id(fill.order_id);
+    common->set_instrument_id(fill.ticker);
+    common->set_user_id(fill.user_id);
+    if (sessions_ == nullptr) {
+        if (fill.connection != nullptr)
+            const_cast<OrderEntryStreamConnection*>(fill.connection)->writeToClient(&orderfill_ack);
+    }
+    else {
+        sessions_->visitPinned(fill.user_id, [](OrderEntryStreamConnection& session) {
+            session.writeToClient(&orderfill_ack);
+        });
+    }
+    logging::Logger::Log(
+        logging::LogType::Info, 
+        util::getLogTimestamp(), 
+        "Order filled with ID:", fill.order_id, 
+        "User ID:", util::ShortString(fill.user_id),
+        "Fill quantity:", fill.fill_qty
+    );
+    md_dispatch_->publish({MarketDataEvent::Type::fill, fill.full_fill, fill.fill_qty,
+        static_cast<uint32_t>(fill.ticker), static_cast<uint64_t>(fill.timestamp), fill.order_id, 0,
+        fill.user_id});
+}
+
+void OrderEntryEventSink::onModify(const info::ModifyOrder& modify_order) {
+    logging::Logger::Log(
+        logging::LogType::Info, 
+        util::getLogTimestamp(), 
+        "Order modified:", modify_order.order_id, 
+        "User ID:", util::ShortString(modify_order.user_id), 
+        "Instrument:", modify_order.ticker, 
+        "To Quantity:", modify_order.quantity, 
+        "Side:", modify_order.is_buy_side
+    );
+    md_dispatch_->publish({MarketDataEvent::Type::modify, 0, modify_order.quantity, 0, 0,
+        modify_order.order_id, 0, 0});
+}
+
+void OrderEntryEventSink::onReplace(const info::ModifyOrder& modify_order) {
+    logging::Logger::Log(
+        logging::LogType::Info, 
+        util::getLogTimestamp(), 
+        "Order replaced:", modify_order.order_id, 
+        "User ID:", util::ShortString(modify_order.user_id), 
+        "Instrument:", modify_order.ticker, 
+        "To Price:", modify_order.price, 
+        "To Quantity:", modify_order.quantity
+    );
+    md_dispatch_->publish({MarketDataEvent::Type::replace, 0, modify_order.quantity, 0,
+        util::getUnixTimestamp(), modify_order.order_id, modify_order.price, 0});
+}
+
+void OrderEntryEventSink::onCancel(const info::CancelOrder& cancel_order) {
+    logging::Logger::Log(
+        logging::LogType::Info, 
+        util::getLogTimestamp(), 
+        "Order cancelled:", cancel_order.order_id, 
+        "User ID:", util::ShortString(cancel_order.user_id), 
+        "Instrument:", cancel_order.ticker
+    );
+    md_dispatch_->publish({MarketDataEvent::Type::cancel, 0, 0, 0, util::getUnixTimestamp(),
+        cancel_order.order_id, 0, 0});
+}
+
+void OrderEntryEventSink::onReject(RejectReason reason, OrderEntryStreamConnection* connection,
+uint64_t user_id, uint64_t order_id, uint64_t ticker) {
+    const auto rejection = static_cast<Rejection>(reason);
+    if (sessions_ == nullptr) {
+        if (connection != nullptr)
+            connection->sendRejection(rejection, user_id, order_id, ticker);
+        return;
+    }
+    sessions_->visitPinned(user_id, [&](OrderEntryStreamConnection& session) {
+        session.sendRejection(rejection, user_id, order_id, ticker);
+    });
+}
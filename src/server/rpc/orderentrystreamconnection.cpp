@@ -1,11 +1,15 @@
 #include "orderentrystreamconnection.hpp"
 
 OrderEntryStreamConnection::OrderEntryStreamConnection(ServiceType* service, 
-grpc::ServerCompletionQueue* completion_q, std::unordered_map<uint64_t, OrderEntryStreamConnection*>& client_streams,
+grpc::ServerCompletionQueue* completion_q, SessionRegistry& client_streams,
 OEJobHandlers& job_handlers)
     : service_(service)
     , completion_queue_(completion_q)
+    , request_block_(new char[REQUEST_BLOCK_SIZE])
+    , request_arena_(request_block_.get(), REQUEST_BLOCK_SIZE)
+    , oe_request_(google::protobuf::Arena::CreateMessage<OERequestType>(&request_arena_))
     , grpc_responder_(&server_context_)
+    , response_queue_(outbound_limits_.capacity)
     , client_streams_(client_streams)
     , server_stream_done_(false)
     , on_streamcancelled_called_(false) 
@@ -35,11 +39,24 @@ thread_local OEResponseType OrderEntryStreamConnection::neworder_ack;
 thread_local OEResponseType OrderEntryStreamConnection::modorder_ack; 
 thread_local OEResponseType OrderEntryStreamConnection::cancelorder_ack; 
 thread_local OEResponseType OrderEntryStreamConnection::rejection_ack;
-std::atomic<uint64_t> OrderEntryStreamConnection::orderid_generator_ = 1;
+util::IDAllocator OrderEntryStreamConnection::orderid_allocator_;
+OutboundLimits OrderEntryStreamConnection::outbound_limits_;
+OutboundStats OrderEntryStreamConnection::outbound_stats_;
 
 void OrderEntryStreamConnection::terminateConnection() {
     logging::Logger::Log(logging::LogType::Info, util::getLogTimestamp(), "Client", user_address_, "connection terminated");
-    client_streams_.erase(userid_);
+    logging::Logger::Log(logging::LogType::Debug, util::getLogTimestamp(), "Client", user_address_,
+        "outbound queue depths", response_queue_depth_.toString());
+    client_streams_.erase(userid_, this); // a rejected duplicate never owned the entry
+    // nothing can pin the session once it is erased, wake a writer waiting for room
+    // and let those already in finish before deleting
+    {
+        std::lock_guard<std::mutex> lock(response_queue_mutex_);
+        disconnecting_ = true;
+    }
+    response_queue_space_.notify_all();
+    while (pins_.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
     delete this;
 }
 
@@ -68,23 +85,23 @@ void OrderEntryStreamConnection::verifyID(bool success) {
     user_address_ = getUserAddress();
     logging::Logger::Log(logging::LogType::Info, util::getLogTimestamp(), "New client connection: ", user_address_);
     orderentry::OrderCommon* common;
-    switch(oe_request_.OrderEntryType_case()) { // slight inefficiency on first conn request
+    switch(oe_request_->OrderEntryType_case()) { // slight inefficiency on first conn request
         case type::kNewOrder: {
-            common = oe_request_.mutable_new_order()->mutable_order_common();
+            common = oe_request_->mutable_new_order()->mutable_order_common();
             break;
         }
         case type::kModifyOrder: {
-            common = oe_request_.mutable_modify_order()->mutable_order_common();
+            common = oe_request_->mutable_modify_order()->mutable_order_common();
             break;
         }
         case type::kCancelOrder: {
-            common = oe_request_.mutable_cancel_order()->mutable_order_common();
+            common = oe_request_->mutable_cancel_order()->mutable_order_common();
             break;
         }
         default:
             break;
     }
-    if (client_streams_.find(common->user_id()) != client_streams_.end()) {
+    if (!client_streams_.insert(common->user_id(), this)) {
         asyncOpFinished();
         logging::Logger::Log(
             logging::LogType::Info, 
@@ -98,20 +115,19 @@ void OrderEntryStreamConnection::verifyID(bool success) {
         *rejection_common = *common;
         rejection->set_rejection_response(orderentry::OrderEntryRejection::wrong_user_id);
         on_streamcancelled_called_ = true;
-        writeToClient(&rejection_ack);
+        queueResponse(rejection_ack, false);
         return;
     }
-    client_streams_.emplace(common->user_id(), this);
     userid_ = common->user_id();
     readOrderEntryCallback(success);
 }
 
 void OrderEntryStreamConnection::initialiseOEConn(bool success) {
-    create_new_conn_fn_();
+    create_new_conn_fn_(completion_queue_); // keep an accept pending on this queue
     asyncOpFinished();
     if (success) {
         asyncOpStarted();
-        grpc_responder_.Read(&oe_request_, &verify_userid_callback_);
+        grpc_responder_.Read(oe_request_, &verify_userid_callback_);
     }
 }
 
@@ -119,26 +135,108 @@ void OrderEntryStreamConnection::readOrderEntryCallback(bool success) {
     asyncOpFinished();
     if (success) {
         processEntry();
+        recycleRequest();
         asyncOpStarted();
-        grpc_responder_.Read(&oe_request_, &read_orderentry_callback_);
+        grpc_responder_.Read(oe_request_, &read_orderentry_callback_);
     }
 }
 
+// called by the matching side, which may wait for room under the block policy
 void OrderEntryStreamConnection::writeToClient(const OEResponseType* response) {
-    std::lock_guard<std::mutex> lock(response_queue_mutex_);
-    response_queue_.push_back(*response);
+    queueResponse(*response, true);
+}
+
+void OrderEntryStreamConnection::queueResponse(const OEResponseType& response, bool may_block) {
+    std::unique_lock<std::mutex> lock(response_queue_mutex_);
+    if (disconnecting_)
+        return;
+    if (response_queue_.full() && !makeRoom(response, lock, may_block))
+        return;
+    response_queue_.push() = response; // copies into the slot's existing buffers
+    const uint64_t depth = response_queue_.size();
+    response_queue_depth_.record(depth);
+    uint64_t max_depth = outbound_stats_.max_depth.load(std::memory_order_relaxed);
+    while (depth > max_depth
+    && !outbound_stats_.max_depth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed));
     if (!write_in_progress_) {
         asyncOpStarted();
-        grpc_responder_.Write(*response, &sendResponseFromQueue_cb_);
+        grpc_responder_.Write(response_queue_.front(), &sendResponseFromQueue_cb_);
         write_in_progress_ = true;
     }
 }
 
+// the queue is full, true once there is room for the response, false if it was
+// folded into a queued one or the session is being dropped
+bool OrderEntryStreamConnection::makeRoom(const OEResponseType& response,
+std::unique_lock<std::mutex>& lock, bool may_block) {
+    switch (outbound_limits_.policy) {
+        case SlowConsumerPolicy::coalesce:
+            if (coalesceFill(response)) {
+                ++outbound_stats_.coalesced;
+                return false;
+            }
+            break;
+        case SlowConsumerPolicy::block:
+            if (may_block) {
+                ++outbound_stats_.blocked;
+                const bool room = response_queue_space_.wait_for(lock, outbound_limits_.block_timeout,
+                    [this](){return !response_queue_.full() || disconnecting_;});
+                if (disconnecting_)
+                    return false;
+                if (room)
+                    return true;
+            }
+            break;
+        default:
+            break;
+    }
+    disconnectSlowConsumer();
+    return false;
+}
+
+// Only fills queued after the last non fill response are candidates, so a merged fill
+// never jumps ahead of an ack or rejection. The front may already be with grpc.
+bool OrderEntryStreamConnection::coalesceFill(const OEResponseType& response) {
+    if (!response.has_fill())
+        return false;
+    const auto& fill = response.fill();
+    const std::size_t first = write_in_progress_ ? 1 : 0;
+    for (std::size_t i = response_queue_.size(); i-- > first;) {
+        OEResponseType& queued = response_queue_[i];
+        if (!queued.has_fill())
+            return false;
+        if (queued.fill().status_common().order_id() != fill.status_common().order_id())
+            continue;
+        auto merged = queued.mutable_fill();
+        merged->set_fill_quantity(merged->fill_quantity() + fill.fill_quantity());
+        merged->set_complete_fill(fill.complete_fill());
+        merged->set_fill_id(fill.fill_id());
+        merged->set_timestamp(fill.timestamp());
+        return true;
+    }
+    return false;
+}
+
+// under response_queue_mutex_, cancelling ends the stream through onStreamCancelled
+void OrderEntryStreamConnection::disconnectSlowConsumer() {
+    disconnecting_ = true;
+    ++outbound_stats_.disconnected;
+    response_queue_space_.notify_all();
+    logging::Logger::Log(
+        logging::LogType::Warning,
+        util::getLogTimestamp(),
+        "Client", user_address_,
+        "disconnected as a slow consumer with", response_queue_.size(), "responses queued"
+    );
+    server_context_.TryCancel();
+}
+
 void OrderEntryStreamConnection::sendResponseFromQueue(bool success) {
     asyncOpFinished();
     std::lock_guard<std::mutex> lock(response_queue_mutex_);
-    response_queue_.pop_front();
-    if (!response_queue_.empty() && success) {
+    response_queue_.pop();
+    response_queue_space_.notify_all();
+    if (!response_queue_.empty() && success && !disconnecting_) {
         asyncOpStarted();
         grpc_responder_.Write(response_queue_.front(), &sendResponseFromQueue_cb_);
     }
@@ -147,24 +245,34 @@ void OrderEntryStreamConnection::sendResponseFromQueue(bool success) {
 }
 
 void OrderEntryStreamConnection::processEntry() {
-    auto order_type = oe_request_.OrderEntryType_case();
+    auto order_type = oe_request_->OrderEntryType_case();
     using type = OERequestType::OrderEntryTypeCase;
     switch(order_type) {
         case type::kNewOrder:
-            oe_request_.mutable_new_order()->mutable_order_common()->set_order_id(++orderid_generator_);
-            handleOrderType(oe_request_.new_order());
+            oe_request_->mutable_new_order()->mutable_order_common()->set_order_id(
+                order_ids_.next(orderid_allocator_));
+            handleOrderType(oe_request_->new_order());
             break;
         case type::kModifyOrder:
-            handleOrderType(oe_request_.modify_order());
+            handleOrderType(oe_request_->modify_order());
             break;
         case type::kCancelOrder:
-            handleOrderType(oe_request_.cancel_order());
+            handleOrderType(oe_request_->cancel_order());
             break;
         default:
             break;
     }
 }
 
+// no read is outstanding here, so the request can be recreated on a fresh arena
+void OrderEntryStreamConnection::recycleRequest() {
+    if (++requests_since_reset_ < REQUESTS_PER_ARENA_RESET)
+        return;
+    request_arena_.Reset();
+    oe_request_ = google::protobuf::Arena::CreateMessage<OERequestType>(&request_arena_);
+    requests_since_reset_ = 0;
+}
+
 void OrderEntryStreamConnection::processOrderEntry(const orderentry::NewOrder& new_order) {
     using namespace tradeorder;
     const auto& order_common = new_order.order_common();
@@ -176,14 +284,14 @@ void OrderEntryStreamConnection::processOrderEntry(const orderentry::NewOrder& n
         info::OrderCommon(
             order_common.order_id(),
             order_common.user_id(),
-            order_common.ticker()
+            order_common.instrument_id()
         )
     );
     add_order_fn_(order);
 }
 
 void OrderEntryStreamConnection::sendRejection(const Rejection rejection, const uint64_t userid,
-const uint64_t orderid, const uint64_t ticker) {
+const uint64_t orderid, const uint64_t instrument) {
     logging::Logger::Log(
         logging::LogType::Info, 
         util::getLogTimestamp(), 
@@ -196,7 +304,7 @@ const uint64_t orderid, const uint64_t ticker) {
     auto common_obj = rejection_obj->mutable_order_common();
     common_obj->set_user_id(userid);
     common_obj->set_order_id(orderid);
-    common_obj->set_ticker(ticker);
+    common_obj->set_instrument_id(instrument);
     asyncOpStarted();
     writeToClient(&rejection_ack);
 }
@@ -212,7 +320,7 @@ void OrderEntryStreamConnection::processOrderEntry(const orderentry::ModifyOrder
         info::OrderCommon(
             order_common.order_id(),
             order_common.user_id(),
-            order_common.ticker()
+            order_common.instrument_id()
         )
     );
     modify_order_fn_(morder);
@@ -224,7 +332,7 @@ void OrderEntryStreamConnection::processOrderEntry(const orderentry::CancelOrder
     info::CancelOrder corder(
         order_common.order_id(),
         order_common.user_id(),
-        order_common.ticker(),
+        order_common.instrument_id(),
         this
     );
     cancel_order_fn_(corder);
@@ -243,7 +351,7 @@ bool OrderEntryStreamConnection::userIDUsageRejection(const orderentry::OrderCom
         *rejection_common = common;
         rejection->set_rejection_response(orderentry::OrderEntryRejection::wrong_user_id);
         on_streamcancelled_called_ = true;
-        writeToClient(&rejection_ack);
+        queueResponse(rejection_ack, false);
         return true;
     }
     return false;
@@ -255,13 +363,13 @@ void OrderEntryStreamConnection::acknowledgeEntry(const orderentry::NewOrder& ne
         util::getLogTimestamp(), 
         "Client", user_address_, 
         "sent new order ack with ID:", new_order.order_common().order_id(),
-        "ticker:", util::ShortString(new_order.order_common().ticker())
+        "instrument:", new_order.order_common().instrument_id()
     );
     auto status = neworder_ack.mutable_new_order_ack();
     *status->mutable_new_order() = new_order;
     *status->mutable_new_order()->mutable_order_common() = new_order.order_common();
     status->set_timestamp(util::getUnixTimestamp());
-    writeToClient(&neworder_ack);
+    queueResponse(neworder_ack, false);
 }
 
 void OrderEntryStreamConnection::acknowledgeEntry(const orderentry::ModifyOrder& modify_order) {
@@ -270,31 +378,27 @@ void OrderEntryStreamConnection::acknowledgeEntry(const orderentry::ModifyOrder&
         util::getLogTimestamp(), 
         "Client", user_address_, 
         "sent modify order ack with ID:", modify_order.order_common().order_id(),
-        "ticker:", util::ShortString(modify_order.order_common().ticker())
+        "instrument:", modify_order.order_common().instrument_id()
     );
     auto status = modorder_ack.mutable_modify_order_ack();
     *status->mutable_modify_order() = modify_order;
     *status->mutable_modify_order()->mutable_order_common() = modify_order.order_common();
     status->set_timestamp(util::getUnixTimestamp());
-    writeToClient(&modorder_ack);
+    queueResponse(modorder_ack, false);
 }
 
-std::chrono::_V2::system_clock::time_point OrderEntryStreamConnection::t0;
-
 void OrderEntryStreamConnection::acknowledgeEntry(const orderentry::CancelOrder& cancel_order) {
     logging::Logger::Log(
         logging::LogType::Info, 
         util::getLogTimestamp(), 
         "Client", user_address_, 
         "sent cancel order ack with ID:", cancel_order.order_common().order_id(),
-        "ticker:", util::ShortString(cancel_order.order_common().ticker())
+        "instrument:", cancel_order.order_common().instrument_id()
     );
-    if (cancel_order.order_common().order_id() == 19)
-        OrderEntryStreamConnection::t0 = std::chrono::high_resolution_clock::now();
     auto status = cancelorder_ack.mutable_cancel_order_ack();
     *(status->mutable_status_common()) = cancel_order.order_common();
     status->set_timestamp(util::getUnixTimestamp());
-    writeToClient(&cancelorder_ack);
+    queueResponse(cancelorder_ack, false);
 }
 
 std::string OrderEntryStreamConnection::getUserAddress() {
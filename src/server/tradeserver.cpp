@@ -4,26 +4,41 @@ using namespace server;
 
 orderentry::OrderEntryService::AsyncService TradeServer::order_entry_service_;
 orderentry::MarketDataService::AsyncService TradeServer::market_data_service_;
-std::unordered_map<user_id, OrderEntryStreamConnection*> TradeServer::client_streams_;
-std::unique_ptr<grpc::ServerCompletionQueue> TradeServer::cq_;
+rpc::AdminServiceType TradeServer::admin_service_;
+rpc::AdminHandlers TradeServer::admin_handlers_;
+SessionRegistry TradeServer::client_streams_;
+std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> TradeServer::cqs_;
 std::unique_ptr<grpc::Server> TradeServer::trade_server_;
+std::unique_ptr<grpc::Server> TradeServer::admin_server_;
+std::unique_ptr<grpc::ServerCompletionQueue> TradeServer::admin_cq_;
+rpc::MarketDataDispatcher TradeServer::marketdata_dispatcher_(nullptr, &market_data_service_);
+std::unique_ptr<MatchingEngine> TradeServer::matching_engine_;
 
 void sigintHandler(int sig_no) {
     TradeServer::shutdownServer();
 }
 
-TradeServer::TradeServer(char* port, const std::string& outputfile="") 
-  : marketdata_dispatcher_(nullptr, &market_data_service_)
-  , ordermanager_(&marketdata_dispatcher_)
+TradeServer::TradeServer(char* port, const std::string& outputfile, uint32_t matching_threads,
+uint32_t rpc_threads, bool pin_rpc_threads, const OutboundLimits& outbound_limits,
+const std::string& market_data_bus, bool pin_matching_threads, const std::string& admin_address,
+uint32_t ladder_ticks)
+  : ordermanager_(rpc::OrderEntryEventSink(&marketdata_dispatcher_, &client_streams_))
+  , ladder_ticks_(ladder_ticks)
 {
     logging::Logger::setOutputFile(outputfile);
+    OrderEntryStreamConnection::outbound_limits_ = outbound_limits;
     std::string server_address("192.168.1.88:" + std::string(port));
     grpc::ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(&order_entry_service_);
     builder.RegisterService(&market_data_service_);
-    cq_ = builder.AddCompletionQueue();
-    marketdata_dispatcher_.setCQ(cq_.get());
+    if (rpc_threads == 0)
+        rpc_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t i = 0; i < rpc_threads; ++i)
+        cqs_.emplace_back(builder.AddCompletionQueue());
+    marketdata_dispatcher_.setCQ(cqs_[0].get());
+    if (!market_data_bus.empty())
+        marketdata_dispatcher_.useSharedMemoryBus(market_data_bus);
     trade_server_ = builder.BuildAndStart();
     logging::Logger::Log(
         logging::LogType::Info, 
@@ -34,29 +49,122 @@ TradeServer::TradeServer(char* port, const std::string& outputfile="")
     sigemptyset(&disposition_.sa_mask);
     disposition_.sa_flags = 0;
     sigaction(SIGINT, &disposition_, NULL);
+    if (matching_threads > 0)
+        matching_engine_.reset(new MatchingEngine(
+            matching_threads, rpc::OrderEntryEventSink(&marketdata_dispatcher_, &client_streams_),
+            MatchingEngine::DEFAULT_RING_CAPACITY, pin_matching_threads
+        ));
+    admin_handlers_.create_orderbook_fn = [this](uint64_t symbol, uint32_t ladder_ticks) {
+        return createOrderBook(symbol, ladder_ticks != 0 ? ladder_ticks : ladder_ticks_);
+    };
+    admin_handlers_.retire_orderbook_fn = &TradeServer::retireOrderBook;
+    startAdminServer(admin_address.empty()
+        ? "127.0.0.1:" + std::to_string(std::stoul(port) + 1) : admin_address);
     for (int i = 0; i < 101; ++i)
-        ordermanager_.createOrderBook(i);
-    ordermanager_.createOrderBook("AAPL");
-    ordermanager_.createOrderBook(123);
-    handleRemoteProcedureCalls();
+        createOrderBook(i, ladder_ticks_);
+    createOrderBook(util::convertStrToEightBytes("AAPL"), ladder_ticks_);
+    createOrderBook(123, ladder_ticks_);
+    if (matching_engine_)
+        startMatchingEngine(matching_threads);
+    handleRemoteProcedureCalls(matching_threads, pin_rpc_threads);
 }
 
 void TradeServer::shutdownServer() {
-    for (const auto& connection : client_streams_)
-        connection.second->onStreamCancelled(true);
+    for (auto* connection : client_streams_.snapshot())
+        connection->onStreamCancelled(true);
     trade_server_.get()->Shutdown();
+    if (admin_server_)
+        admin_server_->Shutdown();
     std::this_thread::sleep_for(std::chrono::seconds(2));
-    cq_.get()->Shutdown();
+    if (matching_engine_)
+        matching_engine_->stop();
+    marketdata_dispatcher_.stop();
+    const auto& outbound = OrderEntryStreamConnection::outbound_stats_;
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Outbound queues max depth", outbound.max_depth.load(), "coalesced", outbound.coalesced.load(),
+        "blocked", outbound.blocked.load(), "slow consumers dropped", outbound.disconnected.load()
+    );
+    for (auto& cq : cqs_)
+        cq->Shutdown();
+    if (admin_cq_)
+        admin_cq_->Shutdown();
     std::cout << "Shutdown.\n";
     exit(0);
 }
 
-void TradeServer::handleRemoteProcedureCalls() {
-    auto rpcprocessor = [this](){
+bool TradeServer::createOrderBook(uint64_t symbol, uint32_t ladder_ticks) {
+    const bool created = matching_engine_
+        ? matching_engine_->createOrderBook(symbol, ladder_ticks)
+        : OrderBookManager::createOrderBook(symbol, ladder_ticks);
+    // books made before the feed is up go out with the whole directory
+    if (created && marketdata_live_)
+        publishInstrument(symbolDirectory().find(symbol), symbol);
+    return created;
+}
+
+bool TradeServer::retireOrderBook(uint64_t symbol) {
+    if (matching_engine_)
+        return matching_engine_->retireOrderBook(symbol);
+    return OrderBookManager::retireOrderBook(symbol);
+}
+
+const SymbolDirectory& TradeServer::symbolDirectory() const {
+    if (matching_engine_)
+        return matching_engine_->symbolDirectory();
+    return OrderBookManager::symbolDirectory();
+}
+
+void TradeServer::publishInstrument(uint32_t instrument_id, uint64_t symbol) {
+    marketdata_dispatcher_.publish({rpc::MarketDataEvent::Type::instrument, 0, 0, instrument_id, 0, 0, symbol, 0});
+}
+
+void TradeServer::publishSymbolDirectory() {
+    for (const auto& entry : symbolDirectory().entries())
+        publishInstrument(entry.first, entry.second);
+    marketdata_live_ = true;
+}
+
+// the rpc threads only decode and hand each request to the thread owning its book
+void TradeServer::startMatchingEngine(uint32_t matching_threads) {
+    job_handlers_.add_order_fn = [](::tradeorder::Order& order) {
+        matching_engine_->addOrder(order);
+    };
+    job_handlers_.modify_order_fn = [](info::ModifyOrder& modify_order) {
+        matching_engine_->modifyOrder(modify_order);
+    };
+    job_handlers_.cancel_order_fn = [](info::CancelOrder& cancel_order) {
+        matching_engine_->cancelOrder(cancel_order);
+    };
+    matching_engine_->enableRebalancing(REBALANCE_INTERVAL);
+    matching_engine_->start();
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Matching engine started with", matching_threads, "matching threads"
+    );
+}
+
+// One thread per completion queue. A session is accepted on one queue and all of its
+// callbacks stay there, so they run on the same thread (and cpu, when pinned).
+// rpc threads are pinned to the cpus after the matching threads.
+void TradeServer::handleRemoteProcedureCalls(uint32_t first_cpu, bool pin_rpc_threads) {
+    const uint32_t num_cpus = std::max(1u, std::thread::hardware_concurrency());
+    auto rpcprocessor = [pin_rpc_threads, first_cpu, num_cpus](uint32_t queue){
+        const uint32_t cpu = (first_cpu + queue) % num_cpus;
+        if (pin_rpc_threads && !util::pinThisThread(cpu)) {
+            logging::Logger::Log(
+                logging::LogType::Warning,
+                util::getLogTimestamp(),
+                "Failed to pin rpc thread to cpu", cpu
+            );
+        }
+        grpc::ServerCompletionQueue* cq = cqs_[queue].get();
         std::function<void(bool)>* callback;
         bool ok;
         for (;;) {
-            GPR_ASSERT(cq_->Next((void**)&callback, &ok));
+            GPR_ASSERT(cq->Next((void**)&callback, &ok));
             (*(callback))(ok);
         }
     };
@@ -65,22 +173,59 @@ void TradeServer::handleRemoteProcedureCalls() {
         exit(1);
         // error
     }
-    makeNewOrderEntryConnection();
-    for (uint i = 0; i < std::thread::hardware_concurrency(); ++i) {
-        threadpool_.emplace_back(std::thread(rpcprocessor));
+    publishSymbolDirectory();
+    for (auto& cq : cqs_)
+        makeNewOrderEntryConnection(cq.get());
+    serveAdminCalls();
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Serving rpcs on", cqs_.size(), "completion queues"
+    );
+    for (uint32_t queue = 1; queue < cqs_.size(); ++queue) {
+        threadpool_.emplace_back(std::thread(rpcprocessor, queue));
     }
-    rpcprocessor();
+    rpcprocessor(0);
+}
+
+// calls are only taken once serveAdminCalls() runs, after the feed is up
+void TradeServer::startAdminServer(const std::string& admin_address) {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(admin_address, grpc::InsecureServerCredentials());
+    builder.RegisterService(&admin_service_);
+    admin_cq_ = builder.AddCompletionQueue();
+    admin_server_ = builder.BuildAndStart();
+    if (!admin_server_) {
+        std::cout << "failed to listen for admin calls on " << admin_address << "\n";
+        exit(1);
+    }
+    logging::Logger::Log(
+        logging::LogType::Info,
+        util::getLogTimestamp(),
+        "Admin service listening on " + admin_address
+    );
+}
+
+// admin calls are rare, one unpinned thread serves them off the order entry queues
+void TradeServer::serveAdminCalls() {
+    new rpc::AdminCall(&admin_service_, admin_cq_.get(), admin_handlers_);
+    threadpool_.emplace_back([](){
+        std::function<void(bool)>* callback;
+        bool ok;
+        while (admin_cq_->Next((void**)&callback, &ok))
+            (*(callback))(ok);
+    });
 }
 
 OEJobHandlers TradeServer::job_handlers_ = {
-    &server::tradeorder::OrderBookManager::addOrder,
-    &server::tradeorder::OrderBookManager::modifyOrder,
-    &server::tradeorder::OrderBookManager::cancelOrder,
+    &OrderBookManager::addOrder,
+    &OrderBookManager::modifyOrder,
+    &OrderBookManager::cancelOrder,
     &makeNewOrderEntryConnection
 };
 
-void TradeServer::makeNewOrderEntryConnection() {
+void TradeServer::makeNewOrderEntryConnection(grpc::ServerCompletionQueue* cq) {
     new OrderEntryStreamConnection(
-        &order_entry_service_, cq_.get(), client_streams_, job_handlers_
+        &order_entry_service_, cq, client_streams_, job_handlers_
     );
 }
@@ -0,0 +1,115 @@
+#include <benchmark/benchmark.h>
+#include <grpcpp/grpcpp.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "orderentry.grpc.pb.h"
+#include "marketdatarecord.hpp"
+#include "shmring.hpp"
+
+// one way latency of a market data record from the server's dispatcher to the data
+// platform, over the shared memory bus and over the grpc stream on loopback. Records
+// are sent one at a time, only when the reader asks, so no queueing is measured.
+
+using MDBatch = orderentry::MarketDataBatch;
+using Clock = std::chrono::steady_clock;
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// a cancel record carrying the time it was written
+static void encodeStamped(std::string& records) {
+    records.clear();
+    char* ptr = util::appendRecord(records, util::cancel_data_len_, 'C');
+    util::serialiseBytes(ptr, nowNs());
+    util::serialiseBytes(ptr, uint64_t{1});
+}
+
+static double secondsSince(const char* record) {
+    int64_t sent;
+    std::memcpy(&sent, record + util::md_header_len_, sizeof(sent));
+    return (nowNs() - sent) / 1e9;
+}
+
+static void BM_SharedMemoryBus(benchmark::State& state) {
+    const std::string name = "/marketdatabusbenchmark";
+    util::ShmRing producer(name, 1 << 16);
+    auto consumer = util::ShmRing::attach(name);
+    std::atomic<uint64_t> requested{0};
+    std::atomic<bool> done{false};
+    std::thread publisher([&]() {
+        std::string records;
+        for (uint64_t sent = 0; !done.load(std::memory_order_acquire);) {
+            if (requested.load(std::memory_order_acquire) == sent) {
+                std::this_thread::yield();
+                continue;
+            }
+            encodeStamped(records);
+            producer.publish(records.data(), records.size());
+            ++sent;
+        }
+    });
+    char record[util::ShmRing::RECORD_SIZE];
+    std::size_t len;
+    for (auto _ : state) {
+        requested.fetch_add(1, std::memory_order_release);
+        while (consumer->read(record, len) != util::ShmRing::ReadResult::ok)
+            std::this_thread::yield(); // lets the publisher run when they share a cpu
+        state.SetIterationTime(secondsSince(record));
+    }
+    done.store(true, std::memory_order_release);
+    publisher.join();
+}
+
+class PacedMarketData final : public orderentry::MarketDataService::Service {
+public:
+    grpc::Status MarketData(grpc::ServerContext* context,
+    const orderentry::InitiateMarketDataStreamRequest*, grpc::ServerWriter<MDBatch>* writer) override {
+        MDBatch batch;
+        for (uint64_t sent = 0; !context->IsCancelled();) {
+            if (requested.load(std::memory_order_acquire) == sent) {
+                std::this_thread::yield();
+                continue;
+            }
+            encodeStamped(*batch.mutable_records());
+            if (!writer->Write(batch))
+                break;
+            ++sent;
+        }
+        return grpc::Status::OK;
+    }
+    std::atomic<uint64_t> requested{0};
+};
+
+static void BM_GrpcStream(benchmark::State& state) {
+    PacedMarketData service;
+    int port = 0;
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(), &port);
+    builder.RegisterService(&service);
+    std::unique_ptr<grpc::Server> server = builder.BuildAndStart();
+    auto stub = orderentry::MarketDataService::NewStub(
+        grpc::CreateChannel("127.0.0.1:" + std::to_string(port), grpc::InsecureChannelCredentials())
+    );
+    grpc::ClientContext context;
+    auto reader = stub->MarketData(&context, orderentry::InitiateMarketDataStreamRequest());
+    MDBatch batch;
+    for (auto _ : state) {
+        service.requested.fetch_add(1, std::memory_order_release);
+        if (!reader->Read(&batch)) {
+            state.SkipWithError("market data stream closed");
+            break;
+        }
+        state.SetIterationTime(secondsSince(batch.records().data()));
+    }
+    context.TryCancel();
+    server->Shutdown();
+}
+
+BENCHMARK(BM_SharedMemoryBus)->UseManualTime();
+BENCHMARK(BM_GrpcStream)->UseManualTime();
+
+BENCHMARK_MAIN();
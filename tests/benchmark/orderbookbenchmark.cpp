@@ -2,14 +2,20 @@
 #include <vector>
 #include <string>
 #include <random>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 #include "orderbookmanager.hpp"
+#include "matchingengine.hpp"
+#include "idallocator.hpp"
 
 // naive orderbook 'micro' benchmarking with 100,000 orders of each type (300k in total)
 // does not benchmark order entry server performance as a whole
 
 using namespace server::tradeorder;
 using namespace ::tradeorder;
+using OrderBookManager = BasicOrderBookManager<NullEventSink>;
 
 constexpr uint64_t NUM_ORDERS = 100000;
 constexpr uint8_t BID_SIDE = 1;
@@ -21,6 +27,14 @@ std::mt19937 rng(dev());
 std::uniform_int_distribution<std::mt19937::result_type> dist10(1, 10);
 std::uniform_int_distribution<std::mt19937::result_type> dist100(1, 100);
 
+// swapping the log file under the logger thread is unsafe, so only do it once per run
+static void setupLogging() {
+    static bool log_file_set = false;
+    if (!log_file_set)
+        logging::Logger::setOutputFile("output.txt");
+    log_file_set = true;
+}
+
 static std::vector<info::CancelOrder> setupCancelOrders(OrderBookManager& m) {
     std::vector<info::CancelOrder> cancels;
     for (uint64_t i = 0; i < NUM_ORDERS / 2; ++i) {
@@ -105,14 +119,15 @@ static std::vector<info::ModifyOrder> setupModifyOrders(OrderBookManager& m) {
     return modifys;
 }
 
+// state.range(0) is the price ladder width per book, 0 benchmarks the plain map book
 static void BM_OrderBook(benchmark::State& state) {
-    logging::Logger::setOutputFile("output.txt");
+    setupLogging();
     for (auto arg : state) {
         state.PauseTiming();
-        OrderBookManager bench_manager(nullptr);
+        OrderBookManager bench_manager;
         OrderBookManager::clearBooks();
         for (uint64_t i = 0; i < 100; ++i) {
-            bench_manager.createOrderBook(i); // 100 instruments
+            bench_manager.createOrderBook(i, state.range(0)); // 100 instruments
         }
         auto adds = setupAddOrders(bench_manager);
         auto mods = setupModifyOrders(bench_manager);
@@ -127,8 +142,8 @@ static void BM_OrderBook(benchmark::State& state) {
 }
 
 static void BM_AddOrderNoFill(benchmark::State& state) {
-    logging::Logger::setOutputFile("output.txt");
-    Order temp(BID_SIDE, nullptr, 98, 100, info::OrderCommon(ORDER_IDS++, util::convertStrToEightBytes("TONY"), util::convertStrToEightBytes("AAPL")));
+    setupLogging();
+    Order temp(BID_SIDE, nullptr, 98, 100, info::OrderCommon(ORDER_IDS++, util::convertStrToEightBytes("TONY"), 0)); // AAPL, the only book
     for (auto arg : state) {
         state.PauseTiming();
         OrderBookManager::clearBooks();
@@ -138,8 +153,131 @@ static void BM_AddOrderNoFill(benchmark::State& state) {
     }
 }
 
-BENCHMARK(BM_OrderBook)->Iterations(5);
+// large aggressive order walking 200 sparse levels, state.range(0) is the ladder width
+static void BM_SweepSparseLevels(benchmark::State& state) {
+    setupLogging();
+    uint64_t ticker = util::convertStrToEightBytes("SWEEP");
+    for (auto arg : state) {
+        state.PauseTiming();
+        OrderBookManager::clearBooks();
+        OrderBookManager::createOrderBook(ticker, state.range(0));
+        const uint64_t instrument = OrderBookManager::instrumentID(ticker);
+        for (uint64_t i = 0; i < 200; ++i) {
+            Order ask(0, nullptr, 1000 + i * 17, 100, info::OrderCommon(ORDER_IDS++, i, instrument));
+            OrderBookManager::addOrder(ask);
+        }
+        Order sweep(BID_SIDE, nullptr, 1000 + 200 * 17, 200 * 100, info::OrderCommon(ORDER_IDS++, 0, instrument));
+        state.ResumeTiming();
+        OrderBookManager::addOrder(sweep);
+    }
+}
+
+// one aggressive order walking a single 10k-order level
+static void BM_SweepDeepLevel(benchmark::State& state) {
+    setupLogging();
+    uint64_t ticker = util::convertStrToEightBytes("DEEP");
+    for (auto arg : state) {
+        state.PauseTiming();
+        OrderBookManager::clearBooks();
+        OrderBookManager::createOrderBook(ticker, 256);
+        const uint64_t instrument = OrderBookManager::instrumentID(ticker);
+        for (uint64_t i = 0; i < 10000; ++i) {
+            Order ask(0, nullptr, 1000, 100, info::OrderCommon(ORDER_IDS++, i, instrument));
+            OrderBookManager::addOrder(ask);
+        }
+        Order sweep(BID_SIDE, nullptr, 1000, 10000 * 100, info::OrderCommon(ORDER_IDS++, 0, instrument));
+        state.ResumeTiming();
+        OrderBookManager::addOrder(sweep);
+    }
+}
+
+// market maker re-quoting one price, so the level is emptied and recreated every time
+static void BM_QuoteFlicker(benchmark::State& state) {
+    setupLogging();
+    uint64_t ticker = util::convertStrToEightBytes("FLICKER");
+    OrderBookManager::clearBooks();
+    OrderBookManager::createOrderBook(ticker, state.range(0));
+    const uint64_t instrument = OrderBookManager::instrumentID(ticker);
+    for (auto arg : state) {
+        uint64_t id = ORDER_IDS++;
+        Order quote(BID_SIDE, nullptr, 1000, 100, info::OrderCommon(id, 1, instrument));
+        OrderBookManager::addOrder(quote);
+        info::CancelOrder cancel(id, 1, instrument, nullptr);
+        OrderBookManager::cancelOrder(cancel);
+    }
+}
+
+// quote/cancel pairs spread over 16 books, submitted from one thread and drained
+// by the matching threads that own the books
+static void BM_MatchingEngine(benchmark::State& state) {
+    setupLogging();
+    constexpr uint64_t NUM_TICKERS = 16;
+    for (auto arg : state) {
+        state.PauseTiming();
+        BasicMatchingEngine<NullEventSink> engine(state.range(0));
+        for (uint64_t ticker = 1; ticker <= NUM_TICKERS; ++ticker)
+            engine.createOrderBook(ticker, 256);
+        engine.start();
+        state.ResumeTiming();
+        for (uint64_t i = 0; i < NUM_ORDERS; ++i) {
+            uint64_t id = ORDER_IDS++, instrument = i % NUM_TICKERS;
+            engine.addOrder(Order(BID_SIDE, nullptr, 1000, 100, info::OrderCommon(id, 1, instrument)));
+            engine.cancelOrder(info::CancelOrder(id, 1, instrument, nullptr));
+        }
+        engine.stop();
+    }
+    state.SetItemsProcessed(state.iterations() * NUM_ORDERS * 2);
+}
+
+// cancel/modify style lookups over 100k live, mostly increasing IDs
+// state.range(0): 0 = std::unordered_map, 1 = direct-mapped OrderIndex
+static void BM_OrderIDLookup(benchmark::State& state) {
+    constexpr uint64_t LIVE_ORDERS = 100000;
+    std::unordered_map<uint64_t, uint32_t> hash_index;
+    OrderIndex direct_index;
+    std::vector<uint64_t> ids;
+    uint64_t id = 1;
+    for (uint32_t i = 0; i < LIVE_ORDERS; ++i) {
+        id += 1 + dist10(rng) / 5; // other books take some of the IDs
+        ids.push_back(id);
+        if (state.range(0) == 0)
+            hash_index.emplace(id, i);
+        else
+            direct_index.insert(id, i);
+    }
+    std::shuffle(ids.begin(), ids.end(), rng);
+    std::size_t next = 0;
+    for (auto arg : state) {
+        uint64_t lookup = ids[next++ % LIVE_ORDERS];
+        if (state.range(0) == 0)
+            benchmark::DoNotOptimize(hash_index.find(lookup)->second);
+        else
+            benchmark::DoNotOptimize(direct_index.find(lookup));
+    }
+}
+
+// every thread hands out order ids, either from one shared counter or from its own blocks
+static void BM_OrderIDAllocation(benchmark::State& state) {
+    static std::atomic<uint64_t> shared_counter{1};
+    static util::IDAllocator allocator;
+    util::IDAllocator::Block block;
+    for (auto arg : state) {
+        if (state.range(0) == 0)
+            benchmark::DoNotOptimize(shared_counter.fetch_add(1));
+        else
+            benchmark::DoNotOptimize(block.next(allocator));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_OrderBook)->ArgName("ladder_ticks")->Arg(0)->Arg(256)->Arg(1024)->Iterations(5);
 BENCHMARK(BM_AddOrderNoFill);
+BENCHMARK(BM_OrderIDLookup)->ArgName("direct_mapped")->Arg(0)->Arg(1);
+BENCHMARK(BM_SweepSparseLevels)->ArgName("ladder_ticks")->Arg(0)->Arg(4096);
+BENCHMARK(BM_SweepDeepLevel);
+BENCHMARK(BM_QuoteFlicker)->ArgName("ladder_ticks")->Arg(0)->Arg(256);
+BENCHMARK(BM_MatchingEngine)->ArgName("shards")->Arg(1)->Arg(4)->Iterations(5)->UseRealTime();
+BENCHMARK(BM_OrderIDAllocation)->ArgName("blocks")->Arg(0)->Arg(1)->ThreadRange(1, 64)->UseRealTime();
 
 BENCHMARK_MAIN();
 
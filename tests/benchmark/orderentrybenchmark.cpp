@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <list>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "orderentry.pb.h"
+#include "boundedqueue.hpp"
+#include "arenaqueue.hpp"
+
+// heap allocations per order on the order entry stream's message handling: responses
+// queued for a session and requests parsed off it. No grpc, only the protobuf work.
+
+using OERequestType = orderentry::OrderEntryRequest;
+using OEResponseType = orderentry::OrderEntryResponse;
+
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete(void* p, std::size_t) noexcept {std::free(p);}
+
+// the acks and fill a resting order typically produces, built once like the
+// connection's thread_local messages
+static std::vector<OEResponseType> orderResponses() {
+    std::vector<OEResponseType> responses(3);
+    auto new_order = responses[0].mutable_new_order_ack()->mutable_new_order();
+    new_order->set_quantity(10);
+    new_order->set_price(100);
+    new_order->mutable_order_common()->set_order_id(1);
+    new_order->mutable_order_common()->set_user_id(2);
+    auto fill = responses[1].mutable_fill();
+    fill->set_fill_quantity(10);
+    fill->mutable_status_common()->set_order_id(1);
+    responses[2].mutable_cancel_order_ack()->mutable_status_common()->set_order_id(1);
+    return responses;
+}
+
+struct ListQueue {
+    explicit ListQueue(std::size_t) {}
+    OEResponseType& push() {return queue.emplace_back();}
+    void pop() {queue.pop_front();}
+    std::size_t size() const {return queue.size();}
+    std::list<OEResponseType> queue;
+};
+
+// range(0) responses stay queued behind the one being written, as with a client
+// that reads a little behind
+template<typename Queue>
+static void BM_ResponseQueue(benchmark::State& state) {
+    const auto responses = orderResponses();
+    const std::size_t backlog = state.range(0);
+    Queue queue(1024);
+    uint64_t orders = 0;
+    const uint64_t before = allocations.load();
+    for (auto _ : state) {
+        for (const auto& response : responses) {
+            queue.push() = response;
+            if (queue.size() > backlog)
+                queue.pop();
+        }
+        ++orders;
+    }
+    state.counters["allocs_per_order"] = static_cast<double>(allocations.load() - before) / orders;
+}
+
+// alternating order types switch the request's oneof, which frees and reallocates
+// the submessage on the heap but only bumps the arena
+static void BM_RequestParse(benchmark::State& state) {
+    const bool use_arena = state.range(0);
+    OERequestType new_order, cancel_order;
+    new_order.mutable_new_order()->set_quantity(10);
+    new_order.mutable_new_order()->mutable_order_common()->set_user_id(2);
+    cancel_order.mutable_cancel_order()->mutable_order_common()->set_order_id(1);
+    const std::string wire[2] = {new_order.SerializeAsString(), cancel_order.SerializeAsString()};
+    constexpr uint32_t requests_per_reset = 256;
+    std::unique_ptr<char[]> block(new char[4096]);
+    google::protobuf::Arena arena(block.get(), 4096);
+    OERequestType heap_request;
+    OERequestType* request = use_arena
+        ? google::protobuf::Arena::CreateMessage<OERequestType>(&arena) : &heap_request;
+    uint64_t orders = 0;
+    const uint64_t before = allocations.load();
+    for (auto _ : state) {
+        request->ParseFromString(wire[orders & 1]);
+        benchmark::DoNotOptimize(request);
+        if (use_arena && ++orders % requests_per_reset == 0) {
+            arena.Reset();
+            request = google::protobuf::Arena::CreateMessage<OERequestType>(&arena);
+        }
+        else if (!use_arena)
+            ++orders;
+    }
+    state.counters["allocs_per_order"] = static_cast<double>(allocations.load() - before) / orders;
+}
+
+BENCHMARK_TEMPLATE(BM_ResponseQueue, ListQueue)->ArgName("backlog")->Arg(0)->Arg(64);
+BENCHMARK_TEMPLATE(BM_ResponseQueue, util::BoundedQueue<OEResponseType>)->ArgName("backlog")->Arg(0)->Arg(64);
+BENCHMARK_TEMPLATE(BM_ResponseQueue, rpc::ArenaQueue<OEResponseType>)->ArgName("backlog")->Arg(0)->Arg(64);
+BENCHMARK(BM_RequestParse)->ArgName("arena")->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
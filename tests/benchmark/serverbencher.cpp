@@ -1,6 +1,7 @@
 #include <grpc/grpc.h>
 #include <grpcpp/grpcpp.h>
 #include <memory>
+#include <atomic>
 #include <vector>
 #include <random>
 #include <string>
@@ -34,7 +35,7 @@ OERequest makeAddOrder(bool is_buy_side, uint64_t price, uint32_t quantity, uint
     auto common = add_order->mutable_order_common();
     common->set_order_id(order_id);
     common->set_user_id(USER_ID);
-    common->set_ticker(ticker);
+    common->set_instrument_id(ticker);
     return temp;
 }
 
@@ -47,7 +48,7 @@ OERequest makeModifyOrder(bool is_buy_side, uint64_t price, uint32_t quantity, u
     auto common = mod_order->mutable_order_common();
     common->set_order_id(order_id);
     common->set_user_id(USER_ID);
-    common->set_ticker(ticker);    
+    common->set_instrument_id(ticker);    
     return temp;
 }
 
@@ -57,7 +58,7 @@ OERequest makeCancelOrder(uint64_t order_id, uint64_t user_id, uint64_t ticker)
     auto common = cancel->mutable_order_common();
     common->set_order_id(order_id);
     common->set_user_id(USER_ID);
-    common->set_ticker(ticker);    
+    common->set_instrument_id(ticker);    
     return temp;
 }
 
@@ -152,13 +153,16 @@ std::vector<OERequest> setupModifyOrders(Writer& writer) {
 }
 
 
+// Prints "user_id,requests,seconds,requests_per_second" once the server has answered
+// everything, timed from the first timed write to the last response.
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         return 1;
     }
     USER_ID = std::atoi(argv[1]);
+    const std::string server_address = argc >= 3 ? argv[2] : "192.168.1.88:9001";
     auto stub(orderentry::OrderEntryService::NewStub(
-        grpc::CreateChannel("192.168.1.88:9001", grpc::InsecureChannelCredentials())
+        grpc::CreateChannel(server_address, grpc::InsecureChannelCredentials())
     ));
     grpc::ClientContext context;
     std::shared_ptr<
@@ -167,11 +171,33 @@ int main(int argc, char* argv[]) {
     auto cancels = setupCancelOrders(oe_stream);
     auto mods = setupModifyOrders(oe_stream);
     auto adds = setupAddOrders(oe_stream);
+    using clock = std::chrono::steady_clock;
+    std::atomic<uint64_t> responses{0};
+    std::atomic<clock::rep> last_response{0};
+    std::thread reader([&](){
+        OEResponse resp;
+        while (oe_stream->Read(&resp)) {
+            last_response = clock::now().time_since_epoch().count();
+            ++responses;
+        }
+    });
+    const auto start = clock::now();
     for (int i = 0; i < NUM_ORDERS; ++i) {
         oe_stream->Write(cancels[i]);
         oe_stream->Write(mods[i]);
         oe_stream->Write(adds[i]);
     }
     using namespace std::chrono_literals;
-    std::this_thread::sleep_for(30s);
+    uint64_t seen;
+    do { // done once the server goes quiet
+        seen = responses;
+        std::this_thread::sleep_for(1s);
+    } while (responses != seen);
+    context.TryCancel();
+    reader.join();
+    const double seconds = std::chrono::duration<double>(
+        clock::duration(last_response.load()) - start.time_since_epoch()).count();
+    const uint64_t requests = 3 * NUM_ORDERS;
+    std::cout << USER_ID << "," << requests << "," << seconds << ","
+        << requests / seconds << std::endl;
 }
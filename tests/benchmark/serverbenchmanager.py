@@ -1,19 +1,43 @@
-from subprocess import Popen
+from subprocess import Popen, PIPE
+import signal
+import sys
 import time
 
-def startServerBenchmark():
-    server = Popen(['../../build/tradeserver', '9001', 'output.txt'])
+BUILD = '../../build'
+STREAM_COUNTS = [1, 2, 4, 8, 16, 32]
+
+# Runs every stream count against a fresh server and prints the aggregate
+# order entry throughput. Usage: [rpc threads] [pin rpc threads 0/1] [matching threads]
+def runServerBenchmark(num_streams, rpc_threads, pin_rpc_threads, matching_threads):
+    server = Popen([BUILD + '/tradeserver', '9001', 'output.txt',
+        str(matching_threads), str(rpc_threads), str(pin_rpc_threads)])
     time.sleep(1)
-    dataplatform = Popen(['../../build/dataplatform', '127.0.0.1', '9001'])
+    dataplatform = Popen([BUILD + '/dataplatform', '127.0.0.1', '9001'])
     time.sleep(1)
     commands = []
-    for i in range(1, 5):
-        commands.append(['../../build/tests/benchmark/serverbencher', '{}'.format(i)])
-    procs = [Popen(i) for i in commands]
-    server.wait()
+    for i in range(1, num_streams + 1):
+        commands.append([BUILD + '/tests/benchmark/serverbencher', '{}'.format(i)])
+    procs = [Popen(i, stdout=PIPE, text=True) for i in commands]
+    throughput = 0.0
+    slowest = 0.0
     for p in procs:
-        p.kill()
+        user, requests, seconds, rate = p.communicate()[0].strip().split(',')
+        throughput += float(rate)
+        slowest = max(slowest, float(seconds))
+    server.send_signal(signal.SIGINT)
+    server.wait()
     dataplatform.kill()
+    return throughput, slowest
+
+def startServerBenchmark():
+    rpc_threads = int(sys.argv[1]) if len(sys.argv) > 1 else 0
+    pin_rpc_threads = int(sys.argv[2]) if len(sys.argv) > 2 else 0
+    matching_threads = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+    print('streams,requests_per_second,slowest_stream_seconds')
+    for num_streams in STREAM_COUNTS:
+        throughput, slowest = runServerBenchmark(
+            num_streams, rpc_threads, pin_rpc_threads, matching_threads)
+        print('{},{:.0f},{:.3f}'.format(num_streams, throughput, slowest))
 
 if __name__ == '__main__':
     startServerBenchmark()
@@ -1,17 +1,31 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+
 #include "orderbookmanager.hpp"
+#include "matchingengine.hpp"
+#include "idallocator.hpp"
+#include "sessiontable.hpp"
+#include "boundedqueue.hpp"
+#include "shmring.hpp"
 
 using namespace server::tradeorder;
 using namespace ::tradeorder;
+using OrderBookManager = BasicOrderBookManager<RecordingEventSink>;
+using OrderBook = OrderBookManager::OrderBook;
+using Event = RecordingEventSink::EventType;
 
 class OrderEntryStreamConnection {}; // test class
 using Conn = OrderEntryStreamConnection;
 
 TEST_CASE("OrderBook Operations") {
     logging::Logger logger;
-    OrderBookManager test_manager(nullptr);
+    OrderBookManager test_manager;
     OrderEntryStreamConnection connobj;
     OrderEntryStreamConnection* conn = &connobj;
     SECTION("Add Order") {
@@ -30,20 +44,21 @@ TEST_CASE("OrderBook Operations") {
         OrderBook& test_book_two = sub_result_two.second;
 
         // add order one to orderbook one
-        tradeorder::Order test_order_one(1, conn, 100, 2000, info::OrderCommon(10, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        tradeorder::Order test_order_one(1, conn, 100, 2000, info::OrderCommon(10, 1, instrument));
         test_manager.addOrder(test_order_one);
         REQUIRE(test_book.numLevels() == 1);
         REQUIRE(test_book.numOrders() == 1);
 
         // add order two to orderbook one
-        Order test_order_two(0, conn, 100, 4000, info::OrderCommon(2, 2, ticker));
+        Order test_order_two(0, conn, 100, 4000, info::OrderCommon(2, 2, instrument));
         test_manager.addOrder(test_order_two);
         REQUIRE(test_book.numLevels() == 1);
         REQUIRE(test_book.numOrders() == 1);
         REQUIRE(test_order_two.getCurrQty() == 2000);
         
         // add order three to orderbook one
-        Order test_order_three(1, conn, 150, 100, info::OrderCommon(100, 200, ticker));
+        Order test_order_three(1, conn, 150, 100, info::OrderCommon(100, 200, instrument));
         test_manager.addOrder(test_order_three);
         auto getorder_res = test_book.getOrder(2);
         REQUIRE(getorder_res.first);
@@ -54,7 +69,7 @@ TEST_CASE("OrderBook Operations") {
         REQUIRE(test_order_three.getCurrQty() == 0);
 
         // add order four to orderbook two
-        Order test_order_four (1, conn, 500, 500, info::OrderCommon(12, 10, util::convertStrToEightBytes("TestTwo")));
+        Order test_order_four (1, conn, 500, 500, info::OrderCommon(12, 10, test_manager.instrumentID("TestTwo")));
         test_manager.addOrder(test_order_four);
 
         // check order numbers and level numbers
@@ -69,13 +84,14 @@ TEST_CASE("OrderBook Operations") {
         auto sub_result = test_manager.subscribe("AddManyOrders");
         REQUIRE(sub_result.first == true);
         OrderBook& orderbook = sub_result.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
         for (int i = 0; i < 200; ++i) {
             if (i % 2 == 0) {
-                Order testorder(1, conn, 100 + i, 100, info::OrderCommon(i, i, ticker));
+                Order testorder(1, conn, 100 + i, 100, info::OrderCommon(i, i, instrument));
                 test_manager.addOrder(testorder);
             }
             else {
-                Order testorder(0, conn, 300 + i, 100, info::OrderCommon(i, i, ticker));
+                Order testorder(0, conn, 300 + i, 100, info::OrderCommon(i, i, instrument));
                 test_manager.addOrder(testorder);
             }
         }
@@ -88,14 +104,15 @@ TEST_CASE("OrderBook Operations") {
         auto sub_result = test_manager.subscribe(ticker);
         REQUIRE(sub_result.first == true);
         OrderBook& orderbook = sub_result.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
         for (int i = 0; i < 200; ++i) {
             if (i % 2 == 0) {
-                Order testorder(1, conn, 100 + i, 10000, info::OrderCommon(i, i, ticker));
+                Order testorder(1, conn, 100 + i, 10000, info::OrderCommon(i, i, instrument));
                 test_manager.addOrder(testorder);
                 REQUIRE((testorder.getCurrQty() == 10000 || testorder.getCurrQty() == 9000));
             }
             else {
-                Order testorder(0, conn, 100 + i, 1000, info::OrderCommon(i, i, ticker));
+                Order testorder(0, conn, 100 + i, 1000, info::OrderCommon(i, i, instrument));
                 test_manager.addOrder(testorder);
                 REQUIRE(testorder.getCurrQty() == 1000);
             }
@@ -109,8 +126,9 @@ TEST_CASE("OrderBook Operations") {
         auto sub_result = test_manager.subscribe(ticker);
         REQUIRE(sub_result.first == true);
         OrderBook& orderbook = sub_result.second;
-        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order match_order(0, conn, 100, 100, info::OrderCommon(2, 2, 22));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order match_order(0, conn, 100, 100, info::OrderCommon(2, 2, NO_INSTRUMENT));
         test_manager.addOrder(test_order);
         test_manager.addOrder(match_order);
         REQUIRE(match_order.getCurrQty() == 100);
@@ -123,8 +141,9 @@ TEST_CASE("OrderBook Operations") {
         auto sub_result = test_manager.subscribe(ticker);
         REQUIRE(sub_result.first == true);
         OrderBook& orderbook = sub_result.second;
-        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order match_order(0, conn, 100, 100, info::OrderCommon(1, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order match_order(0, conn, 100, 100, info::OrderCommon(1, 1, instrument));
         test_manager.addOrder(test_order);
         test_manager.addOrder(match_order);
         REQUIRE(match_order.getCurrQty() == 100);
@@ -137,9 +156,10 @@ TEST_CASE("OrderBook Operations") {
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
-        info::ModifyOrder morder(1, conn, 350, 100, info::OrderCommon(1, 1, ticker));
-        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order order_two(0, conn, 500, 100, info::OrderCommon(2, 2, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::ModifyOrder morder(1, conn, 350, 100, info::OrderCommon(1, 1, instrument));
+        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order order_two(0, conn, 500, 100, info::OrderCommon(2, 2, instrument));
         test_manager.addOrder(order_one);
         test_manager.addOrder(order_two);
         REQUIRE(orderbook.numLevels() == 2);
@@ -155,9 +175,10 @@ TEST_CASE("OrderBook Operations") {
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
-        info::ModifyOrder morder(1, conn, 350, 100, info::OrderCommon(1, 1, ticker));
-        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order order_two(0, conn, 350, 150, info::OrderCommon(2, 2, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::ModifyOrder morder(1, conn, 350, 100, info::OrderCommon(1, 1, instrument));
+        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order order_two(0, conn, 350, 150, info::OrderCommon(2, 2, instrument));
         test_manager.addOrder(order_one);
         test_manager.addOrder(order_two);
         REQUIRE(orderbook.numOrders() == 2);
@@ -172,14 +193,15 @@ TEST_CASE("OrderBook Operations") {
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
-        Order test_order(1, conn, 2000, 100, info::OrderCommon(1, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order test_order(1, conn, 2000, 100, info::OrderCommon(1, 1, instrument));
         test_manager.addOrder(test_order);
         auto getorig_res = orderbook.getOrder(1);
         REQUIRE(getorig_res.first);
         auto orig_order = getorig_res.second;
         REQUIRE(orig_order.getCurrQty() == 100);
         REQUIRE(orig_order.getPrice() == 2000);
-        info::ModifyOrder morder(1, conn, 100, 200, info::OrderCommon(1, 1, ticker));
+        info::ModifyOrder morder(1, conn, 100, 200, info::OrderCommon(1, 1, instrument));
         test_manager.modifyOrder(morder);
         auto getmod_res = orderbook.getOrder(1);
         REQUIRE(getmod_res.first);
@@ -195,7 +217,8 @@ TEST_CASE("OrderBook Operations") {
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
-        info::ModifyOrder morder(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::ModifyOrder morder(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
         test_manager.modifyOrder(morder);
         REQUIRE(orderbook.numLevels() == 0);
         REQUIRE(orderbook.numOrders() == 0);
@@ -203,8 +226,9 @@ TEST_CASE("OrderBook Operations") {
     SECTION("Modify Wrong Side") {
         uint64_t ticker = util::convertStrToEightBytes("ModWrongSide");
         test_manager.createOrderBook(ticker);
-        info::ModifyOrder morder(0, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order test_order(1, conn, 200, 200, info::OrderCommon(1, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::ModifyOrder morder(0, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order test_order(1, conn, 200, 200, info::OrderCommon(1, 1, instrument));
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
@@ -224,8 +248,9 @@ TEST_CASE("OrderBook Operations") {
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
-        info::ModifyOrder morder(1, conn, 200, 150, info::OrderCommon(1, 2, ticker));
-        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::ModifyOrder morder(1, conn, 200, 150, info::OrderCommon(1, 2, instrument));
+        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
         test_manager.addOrder(test_order);
         test_manager.modifyOrder(morder);
         auto getorder_res = orderbook.getOrder(1);
@@ -239,14 +264,15 @@ TEST_CASE("OrderBook Operations") {
     SECTION("Cancel Only Order Left in Level") {
         uint64_t ticker = util::convertStrToEightBytes("CancelOne");
         test_manager.createOrderBook(ticker);
-        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order test_order(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
         test_manager.addOrder(test_order);
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
         REQUIRE(orderbook.numOrders() == 1);
         REQUIRE(orderbook.numLevels() == 1);
-        info::CancelOrder cancel_order(1, 1, ticker, conn);
+        info::CancelOrder cancel_order(1, 1, instrument, conn);
         test_manager.cancelOrder(cancel_order);
         REQUIRE(orderbook.numOrders() == 0);
         REQUIRE(orderbook.numLevels() == 0);
@@ -254,8 +280,9 @@ TEST_CASE("OrderBook Operations") {
     SECTION("Cancel All of Two Orders in Level") {
         uint64_t ticker = util::convertStrToEightBytes("CancelTwo");
         test_manager.createOrderBook(ticker);
-        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order order_two(1, conn, 100, 100, info::OrderCommon(2, 2, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order order_two(1, conn, 100, 100, info::OrderCommon(2, 2, instrument));
         test_manager.addOrder(order_one);
         test_manager.addOrder(order_two);
         auto sub_res = test_manager.subscribe(ticker);
@@ -263,8 +290,8 @@ TEST_CASE("OrderBook Operations") {
         auto& orderbook = sub_res.second;
         REQUIRE(orderbook.numOrders() == 2);
         REQUIRE(orderbook.numLevels() == 1);
-        info::CancelOrder cancel_order_one(1, 1, ticker, conn);
-        info::CancelOrder cancel_order_two(2, 2, ticker, conn);
+        info::CancelOrder cancel_order_one(1, 1, instrument, conn);
+        info::CancelOrder cancel_order_two(2, 2, instrument, conn);
         test_manager.cancelOrder(cancel_order_one);
         REQUIRE(orderbook.numOrders() == 1);
         REQUIRE(orderbook.numLevels() == 1);
@@ -275,13 +302,14 @@ TEST_CASE("OrderBook Operations") {
     SECTION("Cancel Orders in Middle of Queue in Level") {
         uint64_t ticker = util::convertStrToEightBytes("CancelFive");
         test_manager.createOrderBook(ticker);
-        info::CancelOrder cancel_order_three(3, 3, ticker, conn);
-        info::CancelOrder cancel_order_four(4, 4, ticker, conn);
-        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, ticker));
-        Order order_two(1, conn, 100, 100, info::OrderCommon(2, 2, ticker));
-        Order order_three(1, conn, 100, 100, info::OrderCommon(3, 3, ticker));
-        Order order_four(1, conn, 100, 100, info::OrderCommon(4, 4, ticker));
-        Order order_five(1, conn, 100, 100, info::OrderCommon(5, 5, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::CancelOrder cancel_order_three(3, 3, instrument, conn);
+        info::CancelOrder cancel_order_four(4, 4, instrument, conn);
+        Order order_one(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order order_two(1, conn, 100, 100, info::OrderCommon(2, 2, instrument));
+        Order order_three(1, conn, 100, 100, info::OrderCommon(3, 3, instrument));
+        Order order_four(1, conn, 100, 100, info::OrderCommon(4, 4, instrument));
+        Order order_five(1, conn, 100, 100, info::OrderCommon(5, 5, instrument));
         test_manager.addOrder(order_one);
         test_manager.addOrder(order_two);
         test_manager.addOrder(order_three);
@@ -300,7 +328,8 @@ TEST_CASE("OrderBook Operations") {
     SECTION("Cancel Order that Doesn't Exist") { 
         uint64_t ticker = util::convertStrToEightBytes("CancelNonExist");
         test_manager.createOrderBook(ticker);
-        info::CancelOrder cancel_order(1, 1, ticker, conn);
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        info::CancelOrder cancel_order(1, 1, instrument, conn);
         REQUIRE_NOTHROW(test_manager.cancelOrder(cancel_order));
     }
     SECTION("Cancel Someone Else's Order") {
@@ -309,11 +338,862 @@ TEST_CASE("OrderBook Operations") {
         auto sub_res = test_manager.subscribe(ticker);
         REQUIRE(sub_res.first);
         auto& orderbook = sub_res.second;
-        Order test_order(1, conn, 100, 100, info::OrderCommon(2, 2, ticker));
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order test_order(1, conn, 100, 100, info::OrderCommon(2, 2, instrument));
         test_manager.addOrder(test_order);
-        info::CancelOrder cancel_order(2, 1, ticker, conn);
+        info::CancelOrder cancel_order(2, 1, instrument, conn);
         test_manager.cancelOrder(cancel_order);
         REQUIRE(orderbook.numOrders() == 1);
         REQUIRE(orderbook.numLevels() == 1);
     }
+    SECTION("Ladder Book Overflow and Recentering") {
+        uint64_t ticker = util::convertStrToEightBytes("Ladder");
+        REQUIRE(test_manager.createOrderBook(ticker, 16) == true);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        REQUIRE(orderbook.ladderTicks() == 16);
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order bid_one(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order bid_two(1, conn, 99, 100, info::OrderCommon(2, 2, instrument));
+        Order bid_far(1, conn, 50, 100, info::OrderCommon(3, 3, instrument)); // overflow
+        test_manager.addOrder(bid_one);
+        test_manager.addOrder(bid_two);
+        test_manager.addOrder(bid_far);
+        REQUIRE(orderbook.numLevels() == 3);
+        Order bid_new_best(1, conn, 120, 100, info::OrderCommon(4, 4, instrument)); // recentres band
+        test_manager.addOrder(bid_new_best);
+        REQUIRE(orderbook.numLevels() == 4);
+        REQUIRE(orderbook.numOrders() == 4);
+        Order sweep(0, conn, 95, 250, info::OrderCommon(5, 5, instrument));
+        test_manager.addOrder(sweep);
+        REQUIRE(sweep.getCurrQty() == 0);
+        REQUIRE(orderbook.numLevels() == 2);
+        REQUIRE(orderbook.numOrders() == 2);
+        auto getorder_res = orderbook.getOrder(2);
+        REQUIRE(getorder_res.first);
+        REQUIRE(getorder_res.second.getCurrQty() == 50);
+        Order sweep_through(0, conn, 40, 200, info::OrderCommon(6, 6, instrument));
+        test_manager.addOrder(sweep_through);
+        REQUIRE(sweep_through.getCurrQty() == 50);
+        REQUIRE(orderbook.numLevels() == 1);
+        REQUIRE(orderbook.numOrders() == 1);
+        info::CancelOrder cancel_rest(6, 6, instrument, conn);
+        test_manager.cancelOrder(cancel_rest);
+        REQUIRE(orderbook.numLevels() == 0);
+        REQUIRE(orderbook.numOrders() == 0);
+    }
+    SECTION("Ladder Book Cancel After Recentering") {
+        uint64_t ticker = util::convertStrToEightBytes("LadderCx");
+        REQUIRE(test_manager.createOrderBook(ticker, 8) == true);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order ask_one(0, conn, 500, 100, info::OrderCommon(1, 1, instrument));
+        Order ask_two(0, conn, 500, 100, info::OrderCommon(2, 2, instrument));
+        Order ask_better(0, conn, 400, 100, info::OrderCommon(3, 3, instrument)); // moves 500 into overflow
+        test_manager.addOrder(ask_one);
+        test_manager.addOrder(ask_two);
+        test_manager.addOrder(ask_better);
+        REQUIRE(orderbook.numLevels() == 2);
+        info::CancelOrder cancel_better(3, 3, instrument, conn);
+        test_manager.cancelOrder(cancel_better);
+        Order ask_back(0, conn, 502, 100, info::OrderCommon(4, 4, instrument)); // drained ladder recentres on 502
+        test_manager.addOrder(ask_back);
+        REQUIRE(orderbook.numLevels() == 2);
+        info::CancelOrder cancel_one(1, 1, instrument, conn);
+        info::CancelOrder cancel_two(2, 2, instrument, conn);
+        test_manager.cancelOrder(cancel_one);
+        REQUIRE(orderbook.numLevels() == 2);
+        test_manager.cancelOrder(cancel_two);
+        REQUIRE(orderbook.numLevels() == 1);
+        REQUIRE(orderbook.numOrders() == 1);
+        Order take(1, conn, 502, 100, info::OrderCommon(5, 5, instrument));
+        test_manager.addOrder(take);
+        REQUIRE(take.getCurrQty() == 0);
+        REQUIRE(orderbook.numLevels() == 0);
+        REQUIRE(orderbook.numOrders() == 0);
+    }
+    SECTION("Ladder Book Sparse Sweep") {
+        uint64_t ticker = util::convertStrToEightBytes("Sparse");
+        REQUIRE(test_manager.createOrderBook(ticker, 4096) == true);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        for (uint64_t i = 0; i < 50; ++i) {
+            Order ask(0, conn, 1000 + i * 37, 10, info::OrderCommon(i + 1, i + 1, instrument));
+            test_manager.addOrder(ask);
+        }
+        REQUIRE(orderbook.numLevels() == 50);
+        Order sweep(1, conn, 1000 + 24 * 37, 1000, info::OrderCommon(100, 100, instrument));
+        test_manager.addOrder(sweep);
+        REQUIRE(sweep.getCurrQty() == 750);
+        REQUIRE(orderbook.numLevels() == 26);
+        REQUIRE(orderbook.numOrders() == 26);
+        Order take_next(1, conn, 1000 + 25 * 37, 10, info::OrderCommon(101, 101, instrument));
+        test_manager.addOrder(take_next);
+        REQUIRE(take_next.getCurrQty() == 0);
+        REQUIRE(orderbook.numLevels() == 25);
+    }
+    SECTION("Limit Pool Reuse") {
+        uint64_t ticker = util::convertStrToEightBytes("LimPool");
+        test_manager.createOrderBook(ticker);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t capacity = orderbook.limitPoolCapacity();
+        REQUIRE(capacity > 0);
+        uint64_t id = 1;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        for (int round = 0; round < 10; ++round) {
+            for (uint64_t i = 0; i < capacity; ++i) {
+                Order order(1, conn, 100 + (i % 7), 10, info::OrderCommon(id + i, 1, instrument));
+                test_manager.addOrder(order);
+            }
+            REQUIRE(orderbook.numOrders() == capacity);
+            for (uint64_t i = 0; i < capacity; i += 2) {
+                info::CancelOrder cancel(id + i, 1, instrument, conn);
+                test_manager.cancelOrder(cancel);
+            }
+            Order sweep(0, conn, 100, capacity / 2 * 10, info::OrderCommon(id + capacity, 2, instrument));
+            test_manager.addOrder(sweep);
+            REQUIRE(orderbook.numOrders() == 0);
+            id += capacity + 1;
+        }
+        REQUIRE(orderbook.limitPoolCapacity() == capacity);
+    }
+    SECTION("Replace Moves Order Between Levels") {
+        uint64_t ticker = util::convertStrToEightBytes("Replace");
+        test_manager.createOrderBook(ticker, 64);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order bid_one(1, conn, 100, 100, info::OrderCommon(1, 1, instrument));
+        Order bid_two(1, conn, 100, 100, info::OrderCommon(2, 1, instrument));
+        Order bid_three(1, conn, 104, 20, info::OrderCommon(3, 1, instrument));
+        Order ask(0, conn, 105, 50, info::OrderCommon(4, 2, instrument));
+        test_manager.addOrder(bid_one);
+        test_manager.addOrder(bid_two);
+        test_manager.addOrder(bid_three);
+        test_manager.addOrder(ask);
+        info::ModifyOrder cross(1, conn, 105, 80, info::OrderCommon(1, 1, instrument));
+        test_manager.modifyOrder(cross); // trades 50 against the ask, rests 30 at 105
+        REQUIRE(orderbook.getLevel(0, 105) == nullptr);
+        REQUIRE(orderbook.getLevel(1, 105)->getLevelOrderQuantity() == 30);
+        REQUIRE(orderbook.getLevel(1, 100)->getLevelOrderCount() == 1);
+        REQUIRE(orderbook.getOrder(1).second.getCurrQty() == 30);
+        REQUIRE(orderbook.getOrder(1).second.getPrice() == 105);
+        info::ModifyOrder join(1, conn, 104, 60, info::OrderCommon(2, 1, instrument));
+        test_manager.modifyOrder(join); // joins behind order three
+        REQUIRE(orderbook.getLevel(1, 100) == nullptr);
+        REQUIRE(orderbook.getLevel(1, 104)->getLevelOrderCount() == 2);
+        REQUIRE(orderbook.getLevel(1, 104)->getLevelOrderQuantity() == 80);
+        Order sell(0, conn, 104, 50, info::OrderCommon(5, 2, instrument));
+        test_manager.addOrder(sell);
+        REQUIRE_FALSE(orderbook.getOrder(1).first);
+        REQUIRE_FALSE(orderbook.getOrder(3).first);
+        REQUIRE(orderbook.getOrder(2).second.getCurrQty() == 60);
+        info::ModifyOrder fill_out(1, conn, 110, 50, info::OrderCommon(2, 1, instrument));
+        Order resting_ask(0, conn, 108, 50, info::OrderCommon(6, 2, instrument));
+        test_manager.addOrder(resting_ask);
+        test_manager.modifyOrder(fill_out); // fully traded away while replacing
+        REQUIRE(orderbook.numOrders() == 0);
+        REQUIRE(orderbook.numLevels() == 0);
+    }
+    SECTION("Recorded Events") {
+        uint64_t ticker = util::convertStrToEightBytes("Events");
+        test_manager.createOrderBook(ticker);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order ask(0, conn, 100, 50, info::OrderCommon(1, 1, instrument));
+        Order bid(1, conn, 100, 80, info::OrderCommon(2, 2, instrument));
+        test_manager.addOrder(ask);
+        test_manager.addOrder(bid); // two fills for one match, rest 30
+        info::ModifyOrder amend(1, conn, 99, 30, info::OrderCommon(2, 2, instrument));
+        test_manager.modifyOrder(amend);
+        info::CancelOrder stale(1, 1, instrument, conn);
+        test_manager.cancelOrder(stale);
+        const auto& events = orderbook.sink().events();
+        REQUIRE(events.size() == 6);
+        REQUIRE(events[0].type == Event::add);
+        REQUIRE(events[1].type == Event::fill);
+        REQUIRE(events[1].order_id == 1);
+        REQUIRE(events[2].type == Event::fill);
+        REQUIRE(events[2].order_id == 2);
+        REQUIRE(events[3].type == Event::add);
+        REQUIRE(events[3].quantity == 30);
+        REQUIRE(events[4].type == Event::replace);
+        REQUIRE(events[4].price == 99);
+        REQUIRE(events[5].type == Event::reject);
+        REQUIRE(events[5].reason == RejectReason::order_not_found);
+    }
+    SECTION("Each Side Of A Match Gets Its Own Fill") {
+        uint64_t ticker = util::convertStrToEightBytes("Sides");
+        test_manager.createOrderBook(ticker);
+        auto& orderbook = test_manager.subscribe(ticker).second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        OrderEntryStreamConnection resting_conn, aggressor_conn;
+        const uint64_t resting_user = util::convertStrToEightBytes("maker");
+        const uint64_t aggressor_user = util::convertStrToEightBytes("taker");
+        Order ask(0, &resting_conn, 100, 50, info::OrderCommon(1, resting_user, instrument));
+        Order bid(1, &aggressor_conn, 100, 20, info::OrderCommon(2, aggressor_user, instrument));
+        test_manager.addOrder(ask);
+        test_manager.addOrder(bid);
+        const auto& events = orderbook.sink().events();
+        REQUIRE(events.size() == 3);
+        REQUIRE(events[1].type == Event::fill);
+        REQUIRE(events[1].order_id == 1);
+        REQUIRE(events[1].user_id == resting_user);
+        REQUIRE(events[1].connection == &resting_conn);
+        REQUIRE(events[2].type == Event::fill);
+        REQUIRE(events[2].order_id == 2);
+        REQUIRE(events[2].user_id == aggressor_user);
+        REQUIRE(events[2].connection == &aggressor_conn);
+    }
+    SECTION("Journal Sink") {
+        std::stringstream journal;
+        BasicOrderBook<JournalEventSink> orderbook{JournalEventSink(&journal)};
+        uint64_t ticker = util::convertStrToEightBytes("Journal");
+        Order ask(0, conn, 100, 50, info::OrderCommon(1, 1, ticker));
+        Order bid(1, conn, 100, 50, info::OrderCommon(2, 2, ticker));
+        orderbook.addOrder(ask);
+        orderbook.addOrder(bid);
+        REQUIRE(journal.str().size() == 3 * sizeof(JournalEventSink::Record));
+        JournalEventSink::Record record;
+        journal.read(reinterpret_cast<char*>(&record), sizeof(record));
+        REQUIRE(record.type == 'A');
+        REQUIRE(record.order_id == 1);
+        REQUIRE(record.quantity == 50);
+        journal.read(reinterpret_cast<char*>(&record), sizeof(record));
+        REQUIRE(record.type == 'F');
+    }
+    SECTION("Level Reuse On Quote Flicker") {
+        uint64_t ticker = util::convertStrToEightBytes("LvlFlick");
+        test_manager.createOrderBook(ticker);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        for (uint64_t id = 1; id <= 1000; ++id) {
+            Order quote(1, conn, 100 + (id % 3), 10, info::OrderCommon(id, 1, instrument));
+            test_manager.addOrder(quote);
+            info::CancelOrder cancel(id, 1, instrument, conn);
+            test_manager.cancelOrder(cancel);
+            REQUIRE(orderbook.numLevels() == 0);
+        }
+        REQUIRE(orderbook.levelsAllocated() == 1);
+        REQUIRE(orderbook.levelsReused() == 999);
+        Order bid(1, conn, 100, 10, info::OrderCommon(1001, 1, instrument));
+        Order ask(0, conn, 105, 10, info::OrderCommon(1002, 1, instrument));
+        test_manager.addOrder(bid);
+        test_manager.addOrder(ask);
+        REQUIRE(orderbook.levelsAllocated() == 2); // spares are per side
+        REQUIRE(orderbook.getLevel(1, 100)->getLevelOrderQuantity() == 10);
+        REQUIRE(orderbook.getLevel(0, 105)->getLevelOrderQuantity() == 10);
+    }
+    SECTION("Level Aggregates") {
+        uint64_t ticker = util::convertStrToEightBytes("LvlAgg");
+        test_manager.createOrderBook(ticker, 64);
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        auto& orderbook = sub_res.second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        for (uint64_t i = 1; i <= 5; ++i) {
+            Order order(1, conn, 100, 100 * i, info::OrderCommon(i, i, instrument));
+            test_manager.addOrder(order);
+        }
+        const Level* level = orderbook.getLevel(1, 100);
+        REQUIRE(level != nullptr);
+        REQUIRE(level->getLevelOrderCount() == 5);
+        REQUIRE(level->getLevelOrderQuantity() == 1500);
+        Order partial(0, conn, 100, 150, info::OrderCommon(6, 6, instrument)); // fills 1 and half of 2
+        test_manager.addOrder(partial);
+        REQUIRE(level->getLevelOrderCount() == 4);
+        REQUIRE(level->getLevelOrderQuantity() == 1350);
+        info::ModifyOrder mod_up(1, conn, 100, 400, info::OrderCommon(3, 3, instrument));
+        test_manager.modifyOrder(mod_up);
+        REQUIRE(orderbook.getOrder(3).second.getCurrQty() == 400);
+        REQUIRE(level->getLevelOrderQuantity() == 1450);
+        info::ModifyOrder mod_down(1, conn, 100, 50, info::OrderCommon(4, 4, instrument));
+        test_manager.modifyOrder(mod_down);
+        REQUIRE(level->getLevelOrderQuantity() == 1100);
+        info::CancelOrder cancel(5, 5, instrument, conn);
+        test_manager.cancelOrder(cancel);
+        REQUIRE(level->getLevelOrderCount() == 3);
+        REQUIRE(level->getLevelOrderQuantity() == 600);
+        Order clear(0, conn, 100, 600, info::OrderCommon(7, 7, instrument));
+        test_manager.addOrder(clear);
+        REQUIRE(orderbook.getLevel(1, 100) == nullptr);
+        REQUIRE(orderbook.numOrders() == 0);
+    }
+    SECTION("Retire And Recreate Orderbook") {
+        uint64_t ticker = util::convertStrToEightBytes("Retire");
+        REQUIRE(test_manager.createOrderBook(ticker));
+        const uint64_t num_books = test_manager.numOrderBooks();
+        OrderBook& retired_book = test_manager.subscribe(ticker).second;
+        const uint64_t instrument = test_manager.instrumentID(ticker);
+        Order resting(1, conn, 100, 10, info::OrderCommon(1, 1, instrument));
+        test_manager.addOrder(resting);
+        REQUIRE(test_manager.retireOrderBook(ticker));
+        REQUIRE_FALSE(test_manager.retireOrderBook(ticker));
+        REQUIRE(test_manager.numOrderBooks() == num_books - 1);
+        REQUIRE_FALSE(test_manager.subscribe(ticker).first);
+        REQUIRE(retired_book.numOrders() == 0);
+        REQUIRE(retired_book.numLevels() == 0);
+        REQUIRE(retired_book.sink().events().back().type == Event::cancel);
+        REQUIRE(retired_book.sink().events().back().order_id == 1);
+        Order routed(0, conn, 100, 10, info::OrderCommon(2, 2, instrument));
+        test_manager.addOrder(routed); // rejected, the book is no longer routed to
+        retired_book.addOrder(routed); // a caller still holding the book is rejected too
+        REQUIRE(retired_book.numOrders() == 0);
+        REQUIRE(retired_book.sink().events().back().type == Event::reject);
+        REQUIRE(retired_book.sink().events().back().reason == RejectReason::orderbook_not_found);
+        REQUIRE(test_manager.createOrderBook(ticker));
+        REQUIRE(test_manager.instrumentID(ticker) == instrument); // the symbol keeps its id
+        auto sub_res = test_manager.subscribe(ticker);
+        REQUIRE(sub_res.first);
+        REQUIRE(&sub_res.second != &retired_book);
+        REQUIRE(sub_res.second.numOrders() == 0);
+    }
+}
+
+TEST_CASE("Instrument Routing") {
+    OrderBookManager routing_manager;
+    uint64_t ticker = util::convertStrToEightBytes("Routed");
+    REQUIRE(routing_manager.createOrderBook(ticker));
+    OrderBook& orderbook = routing_manager.subscribe(ticker).second;
+    const uint64_t instrument = routing_manager.instrumentID(ticker);
+    const uint64_t num_orders = 20000;
+    // books are created and retired while another thread routes orders
+    std::thread router([instrument, num_orders]() {
+        for (uint64_t id = 1; id <= num_orders; ++id) {
+            Order order(1, nullptr, 100 + id % 50, 10, info::OrderCommon(id, 1, instrument));
+            OrderBookManager::addOrder(order);
+        }
+    });
+    for (uint64_t other = 1; other <= 500; ++other) {
+        REQUIRE(routing_manager.createOrderBook(ticker + other));
+        if (other % 2 == 0)
+            REQUIRE(routing_manager.retireOrderBook(ticker + other - 1));
+    }
+    router.join();
+    REQUIRE(orderbook.numOrders() == num_orders);
+    REQUIRE(orderbook.sink().events().size() == num_orders);
+    for (uint64_t other = 1; other <= 500; ++other) {
+        REQUIRE(routing_manager.subscribe(ticker + other).first == (other % 2 == 0));
+        REQUIRE(routing_manager.instrumentID(ticker + other) == instrument + other);
+    }
+    REQUIRE(routing_manager.symbolDirectory().symbol(instrument) == ticker);
+}
+
+TEST_CASE("Occupancy Bitmap") {
+    std::mt19937 rng(42);
+    for (std::size_t num_bits : {1, 64, 100, 512, 4096, 70000}) {
+        OccupancyBitmap bitmap(num_bits);
+        std::set<std::size_t> reference;
+        REQUIRE(bitmap.empty());
+        std::uniform_int_distribution<std::size_t> dist(0, num_bits - 1);
+        for (int i = 0; i < 2000; ++i) {
+            std::size_t bit = dist(rng);
+            if (reference.count(bit)) {
+                bitmap.clear(bit);
+                reference.erase(bit);
+            }
+            else {
+                bitmap.set(bit);
+                reference.insert(bit);
+            }
+            std::size_t probe = dist(rng);
+            auto next = reference.lower_bound(probe);
+            REQUIRE(bitmap.nextSet(probe) == (next == reference.end() ? OccupancyBitmap::NPOS : *next));
+            auto prev = reference.upper_bound(probe);
+            REQUIRE(bitmap.prevSet(probe) == (prev == reference.begin() ? OccupancyBitmap::NPOS : *(--prev)));
+            REQUIRE(bitmap.empty() == reference.empty());
+        }
+    }
+}
+
+TEST_CASE("Order Index") {
+    OrderIndex index;
+    std::unordered_map<uint64_t, uint32_t> reference;
+    std::mt19937 rng(7);
+    uint64_t next_id = 1;
+    auto check = [&](uint64_t id) {
+        auto itr = reference.find(id);
+        REQUIRE(index.find(id) == (itr == reference.end() ? OrderIndex::NIL : itr->second));
+    };
+    for (int i = 0; i < 200000; ++i) {
+        int action = rng() % 10;
+        if (action < 5) { // mostly monotonic ids with the odd gap
+            next_id += 1 + (rng() % 50 == 0 ? rng() % 5000 : 0);
+            REQUIRE(index.insert(next_id, i));
+            reference.emplace(next_id, i);
+        }
+        else if (action < 9 && !reference.empty()) { // orders die, recent ones more often
+            uint64_t id = next_id - (rng() % 3000);
+            auto itr = reference.find(id);
+            REQUIRE(index.erase(id) == (itr == reference.end() ? OrderIndex::NIL : itr->second));
+            if (itr != reference.end())
+                reference.erase(itr);
+        }
+        else { // straggler far behind the window
+            uint64_t id = rng() % (next_id + 1);
+            if (reference.count(id) == 0) {
+                REQUIRE(index.insert(id, i));
+                reference.emplace(id, i);
+            }
+            else {
+                REQUIRE_FALSE(index.insert(id, i));
+            }
+        }
+        check(next_id - (rng() % 100000));
+        REQUIRE(index.size() == reference.size());
+    }
+    for (const auto& entry : reference)
+        check(entry.first);
+    REQUIRE(index.stragglers() > 0);
+}
+
+// rests an order at the tail of its level, as OrderBook does
+static void restOrder(askbook& book, LimitBook& limits, const Order& order) {
+    Level& level = book.getLevel(order.getPrice());
+    const limit_index idx = limits.emplace(order);
+    level.addToLevel(order.getCurrQty());
+    if (level.head == NO_LIMIT) {
+        level.head = idx;
+    }
+    else {
+        limits[level.tail].next_limit = idx;
+        limits[idx].prev_limit = level.tail;
+    }
+    level.tail = idx;
+}
+
+TEST_CASE("Match Result Buffers") {
+    SECTION("Small Vector Spill") {
+        util::SmallVector<uint64_t, 4> small;
+        for (uint64_t i = 0; i < 4; ++i)
+            small.emplace_back(i);
+        REQUIRE_FALSE(small.onHeap());
+        small.emplace_back(4);
+        REQUIRE(small.onHeap());
+        REQUIRE(small.size() == 5);
+        auto copy = small;
+        auto moved = std::move(small);
+        REQUIRE(small.empty());
+        for (uint64_t i = 0; i < 5; ++i) {
+            REQUIRE(copy[i] == i);
+            REQUIRE(moved[i] == i);
+        }
+    }
+    SECTION("Streamed Fills Match Buffered Fills") {
+        uint64_t ticker = util::convertStrToEightBytes("Stream");
+        askbook buffered_book(16), streamed_book(16);
+        LimitBook buffered_limits, streamed_limits;
+        for (uint64_t id = 1; id <= 12; ++id) {
+            Order ask(0, nullptr, 100 + id % 3, 10, info::OrderCommon(id, id, ticker));
+            restOrder(buffered_book, buffered_limits, ask);
+            restOrder(streamed_book, streamed_limits, ask);
+        }
+        Order buffered_bid(1, nullptr, 102, 115, info::OrderCommon(20, 20, ticker));
+        Order streamed_bid(buffered_bid);
+        auto match_result = server::matching::FIFOMatcher::FIFOMatch(buffered_bid, buffered_book, buffered_limits);
+        REQUIRE(match_result.numFills() == 24);
+        REQUIRE(match_result.getFills().onHeap());
+        REQUIRE(match_result.orderCompletelyFilled());
+        std::vector<Fill> streamed;
+        server::matching::FillStream stream([&](const Fill& fill) {streamed.push_back(fill);});
+        server::matching::FIFOMatcher::FIFOMatch(streamed_bid, streamed_book, streamed_limits, stream);
+        REQUIRE(stream.orderCompletelyFilled());
+        REQUIRE(streamed.size() == match_result.numFills());
+        for (std::size_t i = 0; i < streamed.size(); ++i) {
+            REQUIRE(streamed[i].order_id == match_result.getFills()[i].order_id);
+            REQUIRE(streamed[i].price == match_result.getFills()[i].price);
+            REQUIRE(streamed[i].fill_qty == match_result.getFills()[i].fill_qty);
+        }
+        REQUIRE(streamed_limits.size() == 1);
+        REQUIRE(streamed_book.best()->getLevelOrderQuantity() == 5);
+    }
+}
+
+TEST_CASE("Matching Engine") {
+    SECTION("Ring Keeps Each Producer's Order") {
+        struct Item {uint32_t producer; uint32_t seq;};
+        util::MPSCRing<Item> ring(1024);
+        const uint32_t producers = 4, per_producer = 50000;
+        std::vector<std::thread> threads;
+        for (uint32_t p = 0; p < producers; ++p)
+            threads.emplace_back([&ring, p, per_producer]() {
+                for (uint32_t i = 0; i < per_producer; ++i)
+                    ring.push({p, i});
+            });
+        std::vector<uint32_t> next(producers, 0);
+        Item item;
+        for (uint32_t popped = 0; popped < producers * per_producer;) {
+            if (!ring.tryPop(item))
+                continue;
+            REQUIRE(item.seq == next[item.producer]);
+            ++next[item.producer];
+            ++popped;
+        }
+        for (auto& thread : threads)
+            thread.join();
+        REQUIRE_FALSE(ring.tryPop(item));
+        for (uint32_t count : next)
+            REQUIRE(count == per_producer);
+    }
+    SECTION("Ring Full And Empty") {
+        util::MPSCRing<uint64_t> ring(4);
+        uint64_t value;
+        REQUIRE_FALSE(ring.tryPop(value));
+        for (uint64_t i = 0; i < 4; ++i)
+            REQUIRE(ring.tryPush(i));
+        REQUIRE_FALSE(ring.tryPush(4));
+        REQUIRE(ring.tryPop(value));
+        REQUIRE(value == 0);
+        REQUIRE(ring.tryPush(4));
+        for (uint64_t i = 1; i <= 4; ++i) {
+            REQUIRE(ring.tryPop(value));
+            REQUIRE(value == i);
+        }
+        REQUIRE_THROWS_AS(util::MPSCRing<uint64_t>(6), EngineException);
+    }
+    SECTION("Books Owned By Matching Threads") {
+        BasicMatchingEngine<RecordingEventSink> engine(3, RecordingEventSink(), 256);
+        const uint64_t num_tickers = 8;
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker)
+            REQUIRE(engine.createOrderBook(ticker, 16));
+        REQUIRE_FALSE(engine.createOrderBook(1));
+        engine.start();
+        // queued to the owning thread, ahead of the orders that use it
+        REQUIRE(engine.createOrderBook(num_tickers + 1));
+        REQUIRE(engine.instrumentID(num_tickers + 1) == num_tickers);
+        engine.addOrder(Order(0, nullptr, 100, 10, info::OrderCommon(1, 1, num_tickers)));
+        REQUIRE(engine.retireOrderBook(num_tickers + 1));
+        // one submitting thread per ticker, each book sees its commands in order
+        std::vector<std::thread> threads;
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker)
+            threads.emplace_back([&engine, ticker]() {
+                const uint64_t base = ticker * 1000, instrument = engine.instrumentID(ticker);
+                for (uint64_t i = 0; i < 100; ++i)
+                    engine.addOrder(Order(0, nullptr, 100 + i % 5, 10, info::OrderCommon(base + i, 1, instrument)));
+                engine.addOrder(Order(1, nullptr, 104, 500, info::OrderCommon(base + 100, 2, instrument)));
+                engine.cancelOrder(info::CancelOrder(base + 99, 1, instrument, nullptr));
+                engine.modifyOrder(info::ModifyOrder(0, nullptr, 104, 0, info::OrderCommon(base + 94, 1, instrument)));
+            });
+        for (auto& thread : threads)
+            thread.join();
+        engine.addOrder(Order(0, nullptr, 100, 10, info::OrderCommon(1, 1, 999)));
+        engine.stop();
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker) {
+            auto result = engine.subscribe(ticker);
+            REQUIRE(result.first);
+            auto& orderbook = result.second;
+            REQUIRE(orderbook.numOrders() == 49);
+            REQUIRE(orderbook.getLevel(0, 101) == nullptr);
+            REQUIRE(orderbook.getLevel(0, 102)->getLevelOrderQuantity() == 100);
+            REQUIRE(orderbook.getLevel(0, 104)->getLevelOrderCount() == 19);
+            const auto& events = orderbook.sink().events();
+            REQUIRE(events.size() == 201);
+            for (uint64_t i = 0; i < 100; ++i) {
+                REQUIRE(events[i].type == Event::add);
+                REQUIRE(events[i].order_id == ticker * 1000 + i);
+            }
+            REQUIRE(events[200].type == Event::cancel);
+        }
+        REQUIRE_FALSE(engine.subscribe(999).first);
+        REQUIRE_FALSE(engine.subscribe(num_tickers + 1).first);
+        uint64_t trivial_modifies = 0, missing_books = 0;
+        for (uint32_t shard = 0; shard < engine.numShards(); ++shard) {
+            for (const auto& event : engine.shardSink(shard).events()) {
+                trivial_modifies += event.reason == RejectReason::modification_trivial;
+                missing_books += event.reason == RejectReason::orderbook_not_found;
+            }
+        }
+        REQUIRE(trivial_modifies == num_tickers);
+        REQUIRE(missing_books == 1);
+    }
+    SECTION("Bursts Drain In Batches") {
+        using Engine = BasicMatchingEngine<RecordingEventSink>;
+        Engine engine(1, RecordingEventSink(), 1024);
+        const uint64_t num_tickers = 4, burst = 4 * Engine::MAX_BATCH;
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker)
+            engine.createOrderBook(ticker, 16);
+        // queued before the thread starts, so it sees one full burst
+        for (uint64_t id = 1; id <= burst; ++id)
+            engine.addOrder(Order(0, nullptr, 100 + id % 3, 10, info::OrderCommon(id, 1, id % num_tickers)));
+        engine.start();
+        engine.stop();
+        const auto& batch_sizes = engine.batchSizes(0);
+        REQUIRE(batch_sizes.total() == burst / Engine::MAX_BATCH);
+        REQUIRE(batch_sizes.count(Engine::BatchHistogram::bucketOf(Engine::MAX_BATCH)) == batch_sizes.total());
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker) {
+            const auto& events = engine.subscribe(ticker).second.sink().events();
+            REQUIRE(events.size() == burst / num_tickers);
+            for (std::size_t i = 1; i < events.size(); ++i)
+                REQUIRE(events[i].order_id > events[i - 1].order_id);
+        }
+    }
+    SECTION("Books Move Between Matching Threads In Order") {
+        using Engine = BasicMatchingEngine<RecordingEventSink>;
+        Engine engine(2, RecordingEventSink(), 256);
+        const uint64_t num_tickers = 3, per_ticker = 20000;
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker)
+            engine.createOrderBook(ticker, 16);
+        // stopped, the book just changes hands
+        REQUIRE(engine.migrateOrderBook(3, 1));
+        REQUIRE(engine.shardOf(engine.instrumentID(3)) == 1);
+        REQUIRE_FALSE(engine.migrateOrderBook(3, 1));
+        REQUIRE_FALSE(engine.migrateOrderBook(3, 2));
+        REQUIRE_FALSE(engine.migrateOrderBook(99, 0));
+        engine.start();
+        std::vector<std::thread> threads;
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker)
+            threads.emplace_back([&engine, ticker, per_ticker]() {
+                const uint64_t base = ticker * 100000, instrument = engine.instrumentID(ticker);
+                for (uint64_t i = 0; i < per_ticker; ++i)
+                    engine.addOrder(Order(0, nullptr, 100 + i % 5, 10, info::OrderCommon(base + i, 1, instrument)));
+            });
+        // bounce book 1 between the threads while its orders stream in
+        const instrument_id moving = engine.instrumentID(1);
+        uint32_t moves = 0;
+        for (uint32_t i = 0; i < 50; ++i) {
+            while (engine.migrating())
+                std::this_thread::yield();
+            moves += engine.migrateOrderBook(1, 1 - engine.shardOf(moving));
+        }
+        for (auto& thread : threads)
+            thread.join();
+        engine.stop();
+        REQUIRE(moves == 50);
+        REQUIRE_FALSE(engine.migrating());
+        REQUIRE(engine.shardOf(moving) == 0);
+        for (uint64_t ticker = 1; ticker <= num_tickers; ++ticker) {
+            auto result = engine.subscribe(ticker);
+            REQUIRE(result.first);
+            const auto& events = result.second.sink().events();
+            REQUIRE(events.size() == per_ticker);
+            for (std::size_t i = 1; i < events.size(); ++i)
+                REQUIRE(events[i].order_id == events[i - 1].order_id + 1);
+            REQUIRE(engine.bookLoad(ticker).messages == per_ticker);
+        }
+        REQUIRE(engine.bookLoad(99).messages == 0);
+        for (uint32_t shard = 0; shard < engine.numShards(); ++shard)
+            REQUIRE(engine.shardSink(shard).events().empty());
+    }
+    SECTION("Rebalancer Picks The Book That Evens Load") {
+        using Engine = BasicMatchingEngine<NullEventSink>;
+        // shard 0 at 90% and shard 1 at 10%, moving the 30% book leaves 60/40
+        auto migration = Engine::chooseMigration({600, 300, 100, 0}, {0, 0, 1, 1}, 2, 1000);
+        REQUIRE(migration.book == 1);
+        REQUIRE(migration.to == 1);
+        // even, idle, or one book hotter than the whole gap: nothing to gain
+        REQUIRE(Engine::chooseMigration({500, 500}, {0, 1}, 2, 1000).book == NO_INSTRUMENT);
+        REQUIRE(Engine::chooseMigration({50, 0}, {0, 1}, 2, 1000).book == NO_INSTRUMENT);
+        REQUIRE(Engine::chooseMigration({900, 10}, {0, 1}, 2, 1000).book == NO_INSTRUMENT);
+        // books mid move are left out
+        REQUIRE(Engine::chooseMigration({600, 300, 0}, {Engine::NO_SHARD, 0, 1}, 2, 1000).book == NO_INSTRUMENT);
+        Engine engine(2);
+        REQUIRE_FALSE(engine.rebalance());
+    }
+    SECTION("Batch Size Histogram Buckets") {
+        util::Log2Histogram<7> histogram;
+        for (uint64_t sample : {1, 2, 3, 4, 63, 64, 500})
+            histogram.record(sample);
+        REQUIRE(histogram.count(0) == 1);
+        REQUIRE(histogram.count(1) == 2);
+        REQUIRE(histogram.count(2) == 1);
+        REQUIRE(histogram.count(5) == 1);
+        REQUIRE(histogram.count(6) == 2);
+        REQUIRE(histogram.total() == 7);
+        REQUIRE(histogram.toString() == "1:1 2:2 4:1 8:0 16:0 32:1 64:2");
+    }
+}
+
+TEST_CASE("Order ID Allocation") {
+    SECTION("Blocks Are Consecutive") {
+        util::IDAllocator allocator(1, 4);
+        util::IDAllocator::Block first, second;
+        REQUIRE(first.next(allocator) == 1);
+        REQUIRE(second.next(allocator) == 5);
+        REQUIRE(first.next(allocator) == 2);
+        REQUIRE(first.remaining() == 2);
+        first.next(allocator);
+        first.next(allocator);
+        REQUIRE(first.next(allocator) == 9);
+        REQUIRE_THROWS_AS(util::IDAllocator(1, 0), EngineException);
+    }
+    SECTION("Unique Across Threads") {
+        constexpr uint64_t num_threads = 8, ids_per_thread = 10000;
+        util::IDAllocator allocator(1, 64);
+        std::vector<std::vector<uint64_t>> ids(num_threads);
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < num_threads; ++t)
+            threads.emplace_back([&allocator, &mine = ids[t]](){
+                util::IDAllocator::Block block;
+                for (uint64_t i = 0; i < ids_per_thread; ++i)
+                    mine.push_back(block.next(allocator));
+            });
+        for (auto& thread : threads)
+            thread.join();
+        std::set<uint64_t> all;
+        for (const auto& mine : ids) {
+            REQUIRE(std::is_sorted(mine.begin(), mine.end()));
+            all.insert(mine.begin(), mine.end());
+        }
+        REQUIRE(all.size() == num_threads * ids_per_thread);
+        REQUIRE(*all.begin() == 1);
+        REQUIRE(*all.rbegin() < 1 + num_threads * (ids_per_thread + allocator.blockSize()));
+    }
+}
+
+TEST_CASE("Session Registry") {
+    struct Session {
+        uint64_t writes = 0;
+        uint32_t pins = 0;
+        void pin() {++pins;}
+        void unpin() {--pins;}
+    };
+    SECTION("Insert Visit Erase") {
+        util::SessionTable<Session> sessions(16);
+        Session first, second;
+        const uint64_t user = util::convertStrToEightBytes("trader");
+        REQUIRE(sessions.insert(user, &first));
+        REQUIRE_FALSE(sessions.insert(user, &second));
+        REQUIRE(sessions.visit(user, [](Session& session) {++session.writes;}));
+        REQUIRE(first.writes == 1);
+        REQUIRE_FALSE(sessions.erase(user, &second)); // the rejected duplicate
+        REQUIRE(sessions.contains(user));
+        REQUIRE(sessions.erase(user, &first));
+        REQUIRE_FALSE(sessions.visit(user, [](Session& session) {++session.writes;}));
+        REQUIRE(sessions.size() == 0);
+    }
+    SECTION("Pinned Visit Runs Outside The Lock") {
+        util::SessionTable<Session> sessions(16);
+        Session session;
+        const uint64_t user = util::convertStrToEightBytes("trader");
+        REQUIRE(sessions.insert(user, &session));
+        // erasing takes the write lock, so this would deadlock inside visit()
+        REQUIRE(sessions.visitPinned(user, [&](Session& pinned) {
+            REQUIRE(pinned.pins == 1);
+            REQUIRE(sessions.erase(user, &pinned));
+            ++pinned.writes;
+        }));
+        REQUIRE(session.pins == 0);
+        REQUIRE(session.writes == 1);
+        REQUIRE_FALSE(sessions.visitPinned(user, [](Session& pinned) {++pinned.writes;}));
+    }
+    SECTION("Grows Past Preallocation And Keeps Probe Chains") {
+        util::SessionTable<Session> sessions(16);
+        std::vector<Session> storage(5000);
+        for (uint64_t user = 0; user < storage.size(); ++user)
+            REQUIRE(sessions.insert(user, &storage[user]));
+        for (uint64_t user = 0; user < storage.size(); user += 2)
+            REQUIRE(sessions.erase(user, &storage[user]));
+        REQUIRE(sessions.size() == storage.size() / 2);
+        REQUIRE(sessions.snapshot().size() == storage.size() / 2);
+        for (uint64_t user = 0; user < storage.size(); ++user)
+            REQUIRE(sessions.contains(user) == (user % 2 == 1));
+    }
+    SECTION("Concurrent Connect And Disconnect") {
+        constexpr uint64_t num_threads = 8, users_per_thread = 2000;
+        util::SessionTable<Session> sessions;
+        std::vector<Session> storage(num_threads * users_per_thread);
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < num_threads; ++t)
+            threads.emplace_back([&sessions, &storage, t](){
+                for (uint64_t i = 0; i < users_per_thread; ++i) {
+                    const uint64_t user = t * users_per_thread + i;
+                    sessions.insert(user, &storage[user]);
+                    sessions.visit(user, [](Session& session) {++session.writes;});
+                    if (i % 4 == 0)
+                        sessions.erase(user, &storage[user]);
+                }
+            });
+        for (auto& thread : threads)
+            thread.join();
+        REQUIRE(sessions.size() == num_threads * users_per_thread * 3 / 4);
+        for (const auto& session : storage)
+            REQUIRE(session.writes == 1);
+    }
+}
+
+TEST_CASE("Bounded Queue") {
+    SECTION("Wraps Around In Order") {
+        util::BoundedQueue<uint64_t> queue(3);
+        REQUIRE(queue.empty());
+        uint64_t next_in = 0, next_out = 0;
+        for (int round = 0; round < 10; ++round) {
+            while (!queue.full())
+                queue.push() = next_in++;
+            REQUIRE(queue.size() == 3);
+            REQUIRE(queue.back() == next_in - 1);
+            REQUIRE(queue[1] == next_out + 1);
+            for (int i = 0; i < 2; ++i) {
+                REQUIRE(queue.front() == next_out++);
+                queue.pop();
+            }
+        }
+        REQUIRE(queue.size() == 1);
+        REQUIRE_THROWS_AS(util::BoundedQueue<uint64_t>(0), EngineException);
+    }
+    SECTION("Slots Keep Their Buffers") {
+        util::BoundedQueue<std::vector<uint64_t>> queue(2);
+        queue.push().assign(64, 1);
+        const uint64_t* buffer = queue.front().data();
+        queue.pop();
+        queue.push();
+        queue.push() = {2}; // back in the first slot
+        REQUIRE(queue.back().data() == buffer);
+        REQUIRE(queue.back().size() == 1);
+    }
+}
+
+TEST_CASE("Shared Memory Ring") {
+    using Result = util::ShmRing::ReadResult;
+    const std::string name = "/orderbooktest_ring_" + std::to_string(::getpid());
+    REQUIRE(util::ShmRing::attach(name) == nullptr);
+    util::ShmRing producer(name, 8);
+    auto first = util::ShmRing::attach(name);
+    auto second = util::ShmRing::attach(name);
+    REQUIRE(first != nullptr);
+    REQUIRE(first->capacity() == 8);
+    char record[util::ShmRing::RECORD_SIZE];
+    std::size_t len = 0;
+    SECTION("Every Consumer Reads Every Record In Order") {
+        REQUIRE(first->read(record, len) == Result::empty);
+        for (uint64_t i = 1; i <= 20; ++i) {
+            producer.publish(reinterpret_cast<const char*>(&i), sizeof(i));
+            for (auto* consumer : {first.get(), second.get()}) {
+                REQUIRE(consumer->read(record, len) == Result::ok);
+                REQUIRE(len == sizeof(i));
+                uint64_t value;
+                std::memcpy(&value, record, sizeof(value));
+                REQUIRE(value == i);
+                REQUIRE(consumer->read(record, len) == Result::empty);
+            }
+        }
+        REQUIRE_FALSE(first->finished());
+        producer.close();
+        REQUIRE(first->finished());
+        REQUIRE_THROWS_AS(producer.publish(record, util::ShmRing::RECORD_SIZE + 1), EngineException);
+    }
+    SECTION("A Lapped Consumer Skips Ahead") {
+        for (uint64_t i = 1; i <= 20; ++i)
+            producer.publish(reinterpret_cast<const char*>(&i), sizeof(i));
+        REQUIRE(first->read(record, len) == Result::overrun);
+        REQUIRE(first->lost() == 16); // resumes half a ring behind the newest record
+        for (uint64_t i = 17; i <= 20; ++i) {
+            REQUIRE(first->read(record, len) == Result::ok);
+            uint64_t value;
+            std::memcpy(&value, record, sizeof(value));
+            REQUIRE(value == i);
+        }
+        REQUIRE(first->read(record, len) == Result::empty);
+    }
 }